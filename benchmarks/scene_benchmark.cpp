@@ -0,0 +1,180 @@
+#include "sphere_scene.h"
+#include "camera.h"
+
+#include <GL/glew.h>
+#include <SFML/Window/Context.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Draws a SphereScene offscreen and reports the time of each stage of a frame. Meant for
+// software rendering without a display, for example under llvmpipe:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./scene-benchmark [instances] [frames] [level]
+//
+// The first pass leaves the instances still, so only the first frame uploads them. The second
+// spins them every frame, which culls, packs and uploads the whole scene each time
+static constexpr unsigned int width = 1280;
+static constexpr unsigned int height = 720;
+
+// Same scatter as the scene panel in the application
+static constexpr float extent = 200.0f;
+static constexpr float minRadius = 0.1f;
+static constexpr float maxRadius = 0.5f;
+static constexpr float spinSpeed = 1.0f;
+
+struct FrameTimes
+{
+	double spin = 0.0;
+	double upload = 0.0;
+	double draw = 0.0;
+	double frame = 0.0;
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static FrameTimes runFrames(SphereScene& scene, ThreadPool& threadPool, Shader& shader, const Camera& camera, int frames, bool animate)
+{
+	FrameTimes total {};
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+
+		if (animate)
+		{
+			auto spinStart = std::chrono::steady_clock::now();
+			scene.spin(threadPool, spinSpeed / 60.0f);
+			total.spin += millisecondsSince(spinStart);
+		}
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Timed here, since the scene's own upload time is only updated when there was something to upload
+		auto uploadStart = std::chrono::steady_clock::now();
+		scene.setFrustum(camera.getFrustumPlanes());
+		scene.upload(threadPool);
+		total.upload += millisecondsSince(uploadStart);
+
+		// glFinish makes the draw time include the rasterization, not just the submission
+		auto drawStart = std::chrono::steady_clock::now();
+		scene.render(shader);
+		glFinish();
+		total.draw += millisecondsSince(drawStart);
+
+		total.frame += millisecondsSince(frameStart);
+	}
+
+	return total;
+}
+
+static void printTimes(const char* name, const FrameTimes& total, int frames, const SphereScene& scene)
+{
+	const double n = static_cast<double>(frames);
+
+	// The cull time is the last one, which is every frame's when animated
+	std::printf("%-9s spin %8.3f ms  cull %8.3f ms  cull+pack+upload %8.3f ms  draw %9.3f ms  frame %9.3f ms (%.2f fps), %zu / %zu visible\n",
+		name, total.spin / n, scene.getCullTime(), total.upload / n, total.draw / n, total.frame / n, 1000.0 * n / total.frame,
+		scene.getVisibleCount(), scene.getInstanceCount());
+}
+
+int main(int argc, char** argv)
+{
+	const size_t instanceCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 30;
+	const unsigned int level = argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 1;
+
+	sf::ContextSettings settings;
+	settings.majorVersion = 4;
+	settings.minorVersion = 3;
+	settings.depthBits = 24;
+
+	// An offscreen context, drawing into its own framebuffer below
+	sf::Context context(settings, width, height);
+
+	if (glewInit() != GLEW_OK)
+	{
+		std::cerr << "Could not initialize GLEW\n";
+		return 1;
+	}
+
+	std::cout << "Renderer: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << "\n";
+
+	unsigned int framebuffer = 0;
+	unsigned int renderbuffers[2] {};
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Could not create the framebuffer\n";
+		return 1;
+	}
+
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Relative to the build directory, where the shaders are copied
+	Shader shader("shaders/basic.vs", "shaders/basic.fs");
+
+	Sphere sphere;
+	sphere.init();
+	sphere.generateIcosphere();
+	sphere.subdivide(level);
+	sphere.sendBufferData();
+
+	SphereScene scene;
+	scene.init();
+	scene.addMesh(sphere);
+	scene.setCulling(true);
+
+	ThreadPool& threadPool = sphere.getThreadPool();
+
+	auto scatterStart = std::chrono::steady_clock::now();
+	scene.scatter(threadPool, 0, instanceCount, extent, minRadius, maxRadius);
+	double scatterTime = millisecondsSince(scatterStart);
+
+	// From the center of the scatter cube, as the application starts, so the frustum holds about a quarter of it
+	Camera camera;
+	camera.updateAspectRatio(width, height);
+	camera.update();
+
+	shader.use();
+	glUniformMatrix4fv(shader.getLocation("view"), 1, GL_FALSE, glm::value_ptr(camera.getViewMatrix()));
+	glUniformMatrix4fv(shader.getLocation("projection"), 1, GL_FALSE, glm::value_ptr(camera.getProjectionMatrix()));
+	shader.setFloat("time", 0.0f);
+	shader.setBool("colorEnabled", true);
+
+	std::printf("%zu instances of a level %u icosphere (%zu triangles each), %u threads, %ux%u\n",
+		instanceCount, level, sphere.getTriangleCount(), threadPool.getThreadCount(), width, height);
+	std::printf("scatter %.3f ms, instance data %.1f MB\n", scatterTime,
+		static_cast<double>(instanceCount * sizeof(SphereInstance)) / 1000.0 / 1000.0);
+
+	FrameTimes still = runFrames(scene, threadPool, shader, camera, frames, false);
+	printTimes("Static", still, frames, scene);
+
+	FrameTimes spinning = runFrames(scene, threadPool, shader, camera, frames, true);
+	printTimes("Animated", spinning, frames, scene);
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(2, renderbuffers);
+
+	return 0;
+}
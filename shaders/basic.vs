@@ -1,15 +1,46 @@
 #version 330 core
 
 layout (location = 0) in vec3 inPos;
+// Per instance when instanced is set: center and radius, then a unit quaternion
+layout (location = 1) in vec4 instanceSphere;
+layout (location = 2) in vec4 instanceRotation;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Set when inPos.xy holds octahedral coordinates instead of a position
+uniform bool octahedralPositions;
+// Set when the instance attributes place the sphere instead of model
+uniform bool instanced;
+
 out vec3 position;
 
+// Same decode as decodeOctahedral in src/octahedral.cpp
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec2 e = encoded / 32767.0;
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+
+	return normalize(v);
+}
+
+vec3 rotateByQuaternion(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
-	gl_Position = projection * view * model * vec4(inPos, 1.0);	
-	position = inPos;
+	vec3 pos = octahedralPositions ? decodeOctahedral(inPos.xy) : inPos;
+
+	vec4 worldPos = instanced
+		? vec4(instanceSphere.xyz + instanceSphere.w * rotateByQuaternion(instanceRotation, pos), 1.0)
+		: model * vec4(pos, 1.0);
+
+	gl_Position = projection * view * worldPos;
+	position = pos;
 }
\ No newline at end of file
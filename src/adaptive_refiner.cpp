@@ -0,0 +1,274 @@
+#include "adaptive_refiner.h"
+#include "baked_icosphere.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Beyond this the vertex pool is mostly stale and is rebuilt from the roots
+static constexpr size_t maxPoolVertices = 8 * 1024 * 1024;
+
+void AdaptiveRefiner::reset(ArenaVector<float>& vertices)
+{
+	BakedIcosphere base = getBakedIcosphere(0);
+
+	vertices.assign(base.vertices, base.vertices + base.vertexCount * 3);
+
+	roots.clear();
+
+	for (size_t t = 0; t < base.triangleCount; t++)
+		roots.push_back({base.indices[t * 3], base.indices[t * 3 + 1], base.indices[t * 3 + 2], 0});
+
+	midpoints.reset(0);
+	vertexStamps.clear();
+	activeStamp = 0;
+}
+
+void AdaptiveRefiner::setErrorThreshold(float pixels)
+{
+	errorThreshold = std::max(pixels, 0.01f);
+}
+
+float AdaptiveRefiner::getErrorThreshold() const
+{
+	return errorThreshold;
+}
+
+void AdaptiveRefiner::setMaxLevel(unsigned int level)
+{
+	maxLevel = level;
+}
+
+unsigned int AdaptiveRefiner::getMaxLevel() const
+{
+	return maxLevel;
+}
+
+size_t AdaptiveRefiner::getActiveVertexCount() const
+{
+	return activeVertices;
+}
+
+void AdaptiveRefiner::refine(const AdaptiveView& view, ArenaVector<float>& vertices, ArenaVector<unsigned int>& indices)
+{
+	if (roots.empty() || vertices.size() / 3 > maxPoolVertices)
+		reset(vertices);
+
+	this->vertices = &vertices;
+
+	// Frustum planes in model space
+	const std::array<glm::vec4, 6> planes = extractFrustumPlanes(view.modelViewProjection);
+
+	// Refine each root face down to the level its projected error asks for
+	leaves.clear();
+	stack.assign(roots.rbegin(), roots.rend());
+
+	while (!stack.empty())
+	{
+		Triangle triangle = stack.back();
+		stack.pop_back();
+
+		if (triangle.level < maxLevel && needsRefinement(triangle, view, planes))
+		{
+			const size_t first = stack.size();
+			split(triangle, stack);
+
+			// Children are visited in order, which keeps the output close to generation order
+			std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(first), stack.end());
+		}
+		else
+		{
+			leaves.push_back(triangle);
+		}
+	}
+
+	// Restrict the refinement: a triangle with a neighbour two levels finer, or with finer
+	// neighbours on two or more edges, is split as well, until nothing changes
+	while (true)
+	{
+		markActive();
+
+		bool changed = false;
+		nextLeaves.clear();
+
+		for (const Triangle& triangle : leaves)
+		{
+			const unsigned int corners[3] {triangle.a, triangle.b, triangle.c};
+
+			int hangingEdges = 0;
+			bool tooFine = false;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int from = corners[k];
+				unsigned int to = corners[(k + 1) % 3];
+				unsigned int midpoint = midpoints.find(from, to);
+
+				if (midpoint == MidpointCache::notFound || !isActive(midpoint))
+					continue;
+
+				hangingEdges++;
+
+				unsigned int firstQuarter = midpoints.find(from, midpoint);
+				unsigned int secondQuarter = midpoints.find(midpoint, to);
+
+				tooFine = tooFine ||
+					(firstQuarter != MidpointCache::notFound && isActive(firstQuarter)) ||
+					(secondQuarter != MidpointCache::notFound && isActive(secondQuarter));
+			}
+
+			if (hangingEdges >= 2 || tooFine)
+			{
+				split(triangle, nextLeaves);
+				changed = true;
+			}
+			else
+			{
+				nextLeaves.push_back(triangle);
+			}
+		}
+
+		leaves.swap(nextLeaves);
+
+		if (!changed)
+			break;
+	}
+
+	// Close the remaining T-junctions by splitting each triangle towards its one hanging midpoint
+	markActive();
+	indices.clear();
+
+	for (const Triangle& triangle : leaves)
+	{
+		const unsigned int corners[3] {triangle.a, triangle.b, triangle.c};
+		bool closed = false;
+
+		for (int k = 0; k < 3 && !closed; k++)
+		{
+			unsigned int from = corners[k];
+			unsigned int to = corners[(k + 1) % 3];
+			unsigned int opposite = corners[(k + 2) % 3];
+			unsigned int midpoint = midpoints.find(from, to);
+
+			if (midpoint == MidpointCache::notFound || !isActive(midpoint))
+				continue;
+
+			indices.insert(indices.end(), {from, midpoint, opposite, midpoint, to, opposite});
+			closed = true;
+		}
+
+		if (!closed)
+			indices.insert(indices.end(), {triangle.a, triangle.b, triangle.c});
+	}
+}
+
+bool AdaptiveRefiner::needsRefinement(const Triangle& triangle, const AdaptiveView& view, const std::array<glm::vec4, 6>& planes) const
+{
+	const float* data = vertices->data();
+
+	glm::vec3 a {data[triangle.a * 3], data[triangle.a * 3 + 1], data[triangle.a * 3 + 2]};
+	glm::vec3 b {data[triangle.b * 3], data[triangle.b * 3 + 1], data[triangle.b * 3 + 2]};
+	glm::vec3 c {data[triangle.c * 3], data[triangle.c * 3 + 1], data[triangle.c * 3 + 2]};
+
+	glm::vec3 centroid = (a + b + c) / 3.0f;
+	float boundingRadius = std::max({glm::length(a - centroid), glm::length(b - centroid), glm::length(c - centroid)});
+
+	// The sphere bulges out of the flat triangle, so the bounds include the error itself
+	float error = 1.0f - glm::length(centroid);
+	boundingRadius += error;
+
+	for (const glm::vec4& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), centroid) + plane.w < -boundingRadius)
+			return false;
+	}
+
+	// Skip triangles beyond the horizon: the visible cap is every direction within
+	// acos(1 / distance) of the camera, and the triangle spans its own angle around its center
+	float cameraDistance = glm::length(view.cameraPosition);
+
+	if (cameraDistance > 1.0f)
+	{
+		glm::vec3 center = glm::normalize(centroid);
+		float cameraAngle = std::acos(std::clamp(glm::dot(center, view.cameraPosition / cameraDistance), -1.0f, 1.0f));
+
+		float horizon = std::acos(1.0f / cameraDistance);
+		float spread = std::acos(std::clamp(std::min({glm::dot(center, a), glm::dot(center, b), glm::dot(center, c)}), -1.0f, 1.0f));
+
+		if (cameraAngle > horizon + spread)
+			return false;
+	}
+
+	float distance = std::max(glm::length(centroid - view.cameraPosition) - boundingRadius, 1e-4f);
+
+	return error / distance * view.projectionScale > errorThreshold;
+}
+
+unsigned int AdaptiveRefiner::getMidpoint(unsigned int a, unsigned int b)
+{
+	ArenaVector<float>& pool = *vertices;
+
+	auto [index, inserted] = midpoints.insert(a, b, static_cast<unsigned int>(pool.size() / 3));
+
+	if (inserted)
+	{
+		glm::vec3 midpoint {
+			pool[a * 3] + pool[b * 3],
+			pool[a * 3 + 1] + pool[b * 3 + 1],
+			pool[a * 3 + 2] + pool[b * 3 + 2]};
+
+		midpoint = glm::normalize(midpoint);
+
+		pool.push_back(midpoint.x);
+		pool.push_back(midpoint.y);
+		pool.push_back(midpoint.z);
+	}
+
+	return index;
+}
+
+bool AdaptiveRefiner::isActive(unsigned int vertex) const
+{
+	return vertex < vertexStamps.size() && vertexStamps[vertex] == activeStamp;
+}
+
+void AdaptiveRefiner::split(const Triangle& triangle, std::vector<Triangle>& output)
+{
+	unsigned int ab = getMidpoint(triangle.a, triangle.b);
+	unsigned int bc = getMidpoint(triangle.b, triangle.c);
+	unsigned int ca = getMidpoint(triangle.c, triangle.a);
+
+	unsigned int level = triangle.level + 1;
+
+	// Same split and winding as Sphere::subdivideShared
+	output.push_back({triangle.a, ab, ca, level});
+	output.push_back({ab, triangle.b, bc, level});
+	output.push_back({ca, bc, triangle.c, level});
+	output.push_back({ab, bc, ca, level});
+}
+
+void AdaptiveRefiner::markActive()
+{
+	vertexStamps.resize(vertices->size() / 3, 0);
+
+	// Stamp 0 marks vertices that were never active, so skip it when wrapping around
+	if (++activeStamp == 0)
+	{
+		std::fill(vertexStamps.begin(), vertexStamps.end(), 0);
+		activeStamp = 1;
+	}
+
+	activeVertices = 0;
+
+	for (const Triangle& triangle : leaves)
+	{
+		for (unsigned int vertex : {triangle.a, triangle.b, triangle.c})
+		{
+			if (vertexStamps[vertex] != activeStamp)
+			{
+				vertexStamps[vertex] = activeStamp;
+				activeVertices++;
+			}
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "midpoint_cache.h"
+#include "arena.h"
+
+// Camera state the refinement is evaluated against, in the model space of a unit sphere
+struct AdaptiveView
+{
+	glm::mat4 modelViewProjection {1.0f};
+	glm::vec3 cameraPosition {};
+	// Pixels per unit of error at distance 1: projection[1][1] * viewport height / 2
+	float projectionScale = 1.0f;
+};
+
+// View-dependent icosphere. Each of the 20 root faces is split into four wherever the
+// projected distance between the flat triangle and the sphere exceeds a pixel threshold.
+// Refinement is restricted so that neighbouring triangles differ by at most one level,
+// and triangles next to a finer neighbour are split in two (red-green refinement),
+// which leaves no cracks. Vertices are kept between updates, so moving the camera
+// only adds the midpoints that were never needed before
+class AdaptiveRefiner
+{
+public:
+	AdaptiveRefiner() = default;
+
+	// Starts over from the icosahedron, which becomes the first vertices of `vertices`
+	void reset(ArenaVector<float>& vertices);
+
+	void setErrorThreshold(float pixels);
+	float getErrorThreshold() const;
+
+	void setMaxLevel(unsigned int level);
+	unsigned int getMaxLevel() const;
+
+	// Appends newly needed vertices to `vertices` and writes the triangles for `view` to `indices`
+	void refine(const AdaptiveView& view, ArenaVector<float>& vertices, ArenaVector<unsigned int>& indices);
+
+	// Number of vertices the last refinement used
+	size_t getActiveVertexCount() const;
+
+private:
+	struct Triangle
+	{
+		unsigned int a = 0;
+		unsigned int b = 0;
+		unsigned int c = 0;
+		unsigned int level = 0;
+	};
+
+	bool needsRefinement(const Triangle& triangle, const AdaptiveView& view, const std::array<glm::vec4, 6>& planes) const;
+
+	// Index of the vertex at the midpoint of (a, b), created on first use
+	unsigned int getMidpoint(unsigned int a, unsigned int b);
+	bool isActive(unsigned int vertex) const;
+
+	void split(const Triangle& triangle, std::vector<Triangle>& output);
+	void markActive();
+
+	ArenaVector<float>* vertices = nullptr;
+	MidpointCache midpoints {};
+
+	std::vector<Triangle> roots {};
+	std::vector<Triangle> leaves {};
+	std::vector<Triangle> nextLeaves {};
+	std::vector<Triangle> stack {};
+
+	// Vertices whose stamp matches activeStamp are used by a current leaf
+	std::vector<uint32_t> vertexStamps {};
+	uint32_t activeStamp = 0;
+	size_t activeVertices = 0;
+
+	float errorThreshold = 1.0f;
+	unsigned int maxLevel = 10;
+};
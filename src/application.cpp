@@ -1,9 +1,14 @@
 #include "application.h"
 #include "imgui/imgui.h"
+#include "midpoint_kernel.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <random>
 
-Application::Application()
+Application::Application(const std::string& startupMesh)
 {
 	// Create SFML window context
     sf::ContextSettings settings;
@@ -54,10 +59,30 @@ Application::Application()
 
     shader = Shader("shaders/basic.vs", "shaders/basic.fs");
 
+    // Low icosphere levels come from baked tables, so this should only cost the upload
+    auto sphereStart = std::chrono::steady_clock::now();
+
     sphere.init();
-    sphere.generateIcosphere();
+    scene.init();
+    scene.addMesh(sphere);
+    scene.setCulling(true);
+    sphere.setCacheBudget(static_cast<size_t>(defaultCacheBudgetMB) * 1000 * 1000);
+
+    if (!startupMesh.empty())
+    {
+        meshPath.fill('\0');
+        startupMesh.copy(meshPath.data(), meshPath.size() - 1);
+    }
+
+    // A saved mesh skips generation entirely, falling back to the base icosphere
+    if (startupMesh.empty() || !sphere.loadMapped(startupMesh))
+        sphere.generateIcosphere();
+
     sphere.sendBufferData();
 
+    auto sphereEnd = std::chrono::steady_clock::now();
+    startupSphereTime = std::chrono::duration<double, std::milli>(sphereEnd - sphereStart).count();
+
     camera.setPosition({-2.0f, 0.0f, 0.0f});
     camera.updateAspectRatio(defaultWidth, defaultHeight);
 }
@@ -80,10 +105,27 @@ void Application::run()
         dt = currentTime - lastFrameTime;
         lastFrameTime = currentTime;
 
+        // dt spans the previous frame, so it holds the cost of an upload made in it
+        double frameTime = static_cast<double>(dt) * 1000.0;
+
+        if (uploadCount != sphere.getUploadStats().uploadCount)
+        {
+            uploadCount = sphere.getUploadStats().uploadCount;
+            uploadFrameTime = frameTime;
+        }
+        else
+        {
+            typicalFrameTime = typicalFrameTime == 0.0 ? frameTime : typicalFrameTime * 0.95 + frameTime * 0.05;
+        }
+
         processInput();
         update();
         menu();
         draw();
+
+        // Time from construction until the first frame has been presented
+        if (firstFrameTime == 0.0)
+            firstFrameTime = static_cast<double>(clock.getElapsedTime().asMicroseconds()) / 1000.0;
     }
 }
 
@@ -151,18 +193,18 @@ void Application::processInput()
             }
             else if(key == sf::Keyboard::Up)
             {
-                unsigned int subdivisions = sphere.getSubdivisionLevel();
-                sphere.subdivide(subdivisions + 1);
-                sphere.sendBufferData();
+                MeshKey target = getTargetKey();
+                target.level++;
+                requestMesh(target);
             }
             else if(key == sf::Keyboard::Down)
             {
-                unsigned int subdivisions = sphere.getSubdivisionLevel();
+                MeshKey target = getTargetKey();
 
-                if (subdivisions > 0)
+                if (target.level > 0)
                 {
-                    sphere.subdivide(subdivisions - 1);
-                    sphere.sendBufferData();
+                    target.level--;
+                    requestMesh(target);
                 }
             }
             else if (key == sf::Keyboard::Right)
@@ -197,6 +239,19 @@ void Application::update()
     moveVector = moveVector * movementSpeed * dt;
     camera.moveRelative2D(moveVector);
     camera.update();
+
+    if (animateScene)
+        scene.spin(sphere.getThreadPool(), dt * sceneSpinSpeed);
+
+    // Swap in a mesh the worker finished since the last frame
+    MeshKey key {};
+    double generationTime = 0.0;
+
+    if (generationWorker.takeResult(key, swapVertices, swapIndices, generationTime))
+    {
+        sphere.adoptMesh(key, swapVertices, swapIndices, generationTime);
+        sphere.sendBufferData();
+    }
 }
 
 void Application::menu()
@@ -228,6 +283,7 @@ void Application::menu()
         if (ImGui::Selectable("IcoSphere", type == SphereType::IcoSphere))
         {
             type = SphereType::IcoSphere;
+            generationWorker.cancel();
             sphere.generateIcosphere();
             sphere.sendBufferData();
         }
@@ -235,30 +291,100 @@ void Application::menu()
         if (ImGui::Selectable("CubeSphere", type == SphereType::CubeSphere))
         {
             type = SphereType::CubeSphere;
-            sphere.generateCubesphere();
+            generationWorker.cancel();
+            sphere.generateCubesphere(sphere.getCubeResolution(), sphere.getCubeWarp());
             sphere.sendBufferData();
         }
 
         if (ImGui::Selectable("SectorSphere", type == SphereType::SectorSphere))
         {
             type = SphereType::SectorSphere;
+            generationWorker.cancel();
             sphere.generateSectorsphere(defaultSectors, defaultStacks);
             sphere.sendBufferData();
         }
 
+        if (ImGui::Selectable("Adaptive IcoSphere", type == SphereType::AdaptiveIcoSphere))
+        {
+            type = SphereType::AdaptiveIcoSphere;
+            generationWorker.cancel();
+            sphere.generateAdaptiveIcosphere();
+            sphere.sendBufferData();
+        }
+
+        if (ImGui::Selectable("FibonacciSphere", type == SphereType::FibonacciSphere))
+        {
+            type = SphereType::FibonacciSphere;
+            generationWorker.cancel();
+            sphere.generateFibonacciSphere(defaultFibonacciPoints);
+            sphere.sendBufferData();
+        }
+
+        if (ImGui::Selectable("HEALPix", type == SphereType::HEALPix))
+        {
+            type = SphereType::HEALPix;
+            generationWorker.cancel();
+            sphere.generateHealpixSphere();
+            sphere.sendBufferData();
+        }
+
+        if (ImGui::Selectable("OctaSphere", type == SphereType::OctaSphere))
+        {
+            type = SphereType::OctaSphere;
+            generationWorker.cancel();
+            sphere.generateOctasphere(sphere.getOctaResolution());
+            sphere.sendBufferData();
+        }
+
+        ImGui::TreePop();
+    }
+
+    ImGui::NewLine();
+
+    if (ImGui::TreeNodeEx("Subdivision Mode", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        MeshKey target = getTargetKey();
+        SubdivisionMode mode = target.mode;
+
+        if (ImGui::Selectable("Shared Vertices", mode == SubdivisionMode::SharedVertices))
+            target.mode = SubdivisionMode::SharedVertices;
+
+        if (ImGui::Selectable("Direct", mode == SubdivisionMode::Direct))
+            target.mode = SubdivisionMode::Direct;
+
+        if (ImGui::Selectable("Duplicated", mode == SubdivisionMode::Duplicated))
+            target.mode = SubdivisionMode::Duplicated;
+
+        if (target.mode != mode)
+            requestMesh(target);
+
         ImGui::TreePop();
     }
 
     ImGui::NewLine();
     ImGui::PushItemWidth(100);
 
-    int subdivisions = static_cast<int>(sphere.getSubdivisionLevel());
+    MeshKey target = getTargetKey();
+
+    int subdivisions = static_cast<int>(target.level);
     if (ImGui::InputInt("Subdivisions", &subdivisions, 1, 1))
     {
-        subdivisions = std::max(subdivisions, 0);
+        target.level = static_cast<unsigned int>(std::max(subdivisions, 0));
+        requestMesh(target);
+    }
 
-        sphere.subdivide(subdivisions);
-        sphere.sendBufferData();
+    int threads = static_cast<int>(sphere.getThreadCount());
+    if (ImGui::InputInt("Threads", &threads, 1, 1))
+    {
+        threads = std::max(threads, 1);
+        sphere.setThreadCount(static_cast<unsigned int>(threads));
+    }
+
+    int cacheBudgetMB = static_cast<int>(sphere.getCacheBudget() / 1000 / 1000);
+    if (ImGui::InputInt("Level Cache (MB)", &cacheBudgetMB, 16, 64))
+    {
+        cacheBudgetMB = std::max(cacheBudgetMB, 0);
+        sphere.setCacheBudget(static_cast<size_t>(cacheBudgetMB) * 1000 * 1000);
     }
 
     float radius = sphere.getRadius();
@@ -268,19 +394,152 @@ void Application::menu()
         sphere.setRadius(radius);
     }
 
+    // Picks the type and parameters from predicted counts and error, then builds only that mesh
+    ImGui::InputInt("Triangle Budget", &triangleBudget, 1000, 100000);
+    triangleBudget = std::max(triangleBudget, 1);
+
+    if (ImGui::Button("Fit Budget"))
+    {
+        meshFit = {};
+        meshFitTried = true;
+        // The choice Sphere::generateForBudget makes, built in the background
+        if (sphere.chooseForBudget(static_cast<size_t>(triangleBudget), meshFit))
+            requestMesh(meshFit.key);
+    }
+
+    ImGui::InputFloat("Max Error", &maxRadialError, 0.0001f, 0.001f, "%.6f");
+    maxRadialError = std::max(maxRadialError, 0.0f);
+
+    if (ImGui::Button("Fit Error"))
+    {
+        meshFit = {};
+        meshFitTried = true;
+        if (sphere.chooseForError(maxRadialError, meshFit))
+            requestMesh(meshFit.key);
+    }
+
+    if (meshFit.triangleCount > 0)
+    {
+        ImGui::Text("Fit: %zu triangles, %zu vertices, predicted error %.2e",
+            meshFit.triangleCount, meshFit.vertexCount, meshFit.error);
+    }
+    else if (meshFitTried)
+    {
+        ImGui::Text("Fit: nothing matches");
+    }
+
+    if (type == SphereType::CubeSphere)
+    {
+        ImGui::NewLine();
+
+        MeshKey cubeTarget = getTargetKey();
+
+        int resolution = static_cast<int>(cubeTarget.resolution);
+        bool warp = cubeTarget.warp;
+
+        bool resolutionChanged = ImGui::InputInt("Resolution", &resolution, 1, 1);
+        bool warpChanged = ImGui::Checkbox("Equal-Angle Warp", &warp);
+
+        if (resolutionChanged || warpChanged)
+        {
+            cubeTarget.resolution = static_cast<unsigned int>(std::max(resolution, 1));
+            cubeTarget.warp = warp;
+            cubeTarget.level = 0;
+
+            requestMesh(cubeTarget);
+        }
+    }
+
     if(type == SphereType::SectorSphere)
     { 
         ImGui::NewLine();
 
-        int sectors = static_cast<int>(sphere.getSectors());
-        int stacks = static_cast<int>(sphere.getStacks());
+        MeshKey sectorTarget = getTargetKey();
+
+        int sectors = static_cast<int>(sectorTarget.sectors);
+        int stacks = static_cast<int>(sectorTarget.stacks);
 
         if (ImGui::InputInt("Sectors", &sectors, 1, 1) ||
             ImGui::InputInt("Stacks", &stacks, 1, 1))
         {
-            sphere.generateSectorsphere(sectors, stacks);
+            sectorTarget.sectors = static_cast<unsigned int>(std::max(sectors, 3));
+            sectorTarget.stacks = static_cast<unsigned int>(std::max(stacks, 2));
+            sectorTarget.level = 0;
+
+            requestMesh(sectorTarget);
+        }
+    }
+
+    if (type == SphereType::FibonacciSphere)
+    {
+        ImGui::NewLine();
+
+        int points = static_cast<int>(sphere.getFibonacciPointCount());
+        if (ImGui::InputInt("Points", &points, 1000, 100000))
+        {
+            sphere.generateFibonacciSphere(static_cast<size_t>(std::max(points, 1)));
             sphere.sendBufferData();
         }
+
+        ImGui::Text("Nearest point to camera: %zu", sphere.findNearestPoint(camera.getPosition()));
+    }
+
+    if (type == SphereType::OctaSphere)
+    {
+        ImGui::NewLine();
+
+        MeshKey octaTarget = getTargetKey();
+
+        int resolution = static_cast<int>(octaTarget.resolution);
+        if (ImGui::InputInt("Resolution", &resolution, 1, 1))
+        {
+            octaTarget.resolution = static_cast<unsigned int>(std::max(resolution, 1));
+            octaTarget.level = 0;
+
+            requestMesh(octaTarget);
+        }
+
+        if (ImGui::Button("Compare With IcoSphere"))
+            compareWithIcosphere();
+
+        const char* comparisonNames[] = {"IcoSphere", "OctaSphere"};
+
+        for (size_t i = 0; i < shapeComparison.size(); i++)
+        {
+            const ShapeComparison& result = shapeComparison[i];
+
+            if (result.time > 0.0)
+            {
+                ImGui::Text("%-10s %zu triangles: %.1f M/s, max error %.2e",
+                    comparisonNames[i], result.triangles, result.triangles / result.time / 1000.0, result.error);
+            }
+        }
+    }
+
+    if (type == SphereType::HEALPix)
+    {
+        ImGui::NewLine();
+
+        ImGui::Text("Nside: %u (%zu pixels)", sphere.getHealpixNside(), getHealpixPixelCount(sphere.getSubdivisionLevel()));
+        ImGui::Text("Pixel under camera: %u", sphere.findPixel(camera.getPosition()));
+
+        if (ImGui::Button("Measure Binning"))
+            measureBinning();
+
+        if (binningTimes[0] > 0.0)
+        {
+            ImGui::Text("%zu samples: %.2f ms batched, %.2f ms one by one (%.2fx)",
+                binningSamples, binningTimes[0], binningTimes[1], binningTimes[1] / binningTimes[0]);
+        }
+    }
+
+    if (type == SphereType::AdaptiveIcoSphere)
+    {
+        ImGui::NewLine();
+
+        float pixelError = sphere.getAdaptiveErrorThreshold();
+        if (ImGui::InputFloat("Pixel Error", &pixelError, 0.25f, 1.0f))
+            sphere.setAdaptiveErrorThreshold(std::max(pixelError, 0.25f));
     }
 
     ImGui::NewLine();
@@ -310,6 +569,27 @@ void Application::menu()
 
     ImGui::NewLine();
 
+    if (ImGui::TreeNodeEx("Upload Method", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        UploadMethod method = sphere.getUploadMethod();
+
+        if (ImGui::Selectable("Persistent Staging", method == UploadMethod::PersistentStaging))
+            method = UploadMethod::PersistentStaging;
+
+        if (ImGui::Selectable("Orphan", method == UploadMethod::Orphan))
+            method = UploadMethod::Orphan;
+
+        if (ImGui::Selectable("Reallocate", method == UploadMethod::Reallocate))
+            method = UploadMethod::Reallocate;
+
+        sphere.setUploadMethod(method);
+        scene.setUploadMethod(method);
+
+        ImGui::TreePop();
+    }
+
+    ImGui::NewLine();
+
     if (drawMode == GL_POINT)
     {
         float pointSize {};
@@ -323,16 +603,197 @@ void Application::menu()
     }
 
     ImGui::Checkbox("Colorful Mode", &colorful);
+
+    bool octahedral = sphere.getVertexFormat() == VertexFormat::Octahedral;
+    if (ImGui::Checkbox("Octahedral Positions", &octahedral))
+    {
+        sphere.setVertexFormat(octahedral ? VertexFormat::Octahedral : VertexFormat::Float3);
+        sphere.sendBufferData();
+    }
+
+    bool clusterCulling = sphere.getClusterCulling();
+    if (ImGui::Checkbox("Cluster Culling", &clusterCulling))
+    {
+        sphere.setClusterCulling(clusterCulling);
+        sphere.sendBufferData();
+    }
+
+    bool optimizeCache = sphere.getVertexCacheOptimization();
+    if (ImGui::Checkbox("Vertex Cache Optimization", &optimizeCache))
+    {
+        sphere.setVertexCacheOptimization(optimizeCache);
+        sphere.sendBufferData();
+    }
+
     ImGui::NewLine();
 
     size_t numVertices = sphere.getVertexCount();
-    float vertexMemoryMB = static_cast<float>(numVertices * 3 * sizeof(float)) / 1000.0f / 1000.0f;
+    float vertexMemoryMB = static_cast<float>(numVertices * sphere.getVertexStride()) / 1000.0f / 1000.0f;
     
     size_t numTriangles = sphere.getTriangleCount();
-    float triangleMemoryMB = static_cast<float>(numTriangles * 3 * sizeof(unsigned int)) / 1000.0f / 1000.0f;
+    size_t indexWidth = sphere.getIndexWidth();
+    float triangleMemoryMB = static_cast<float>(numTriangles * 3 * indexWidth) / 1000.0f / 1000.0f;
 
     ImGui::Text("Vertices: %zu (%.4f MB)", numVertices, vertexMemoryMB);
-    ImGui::Text("Triangles: %zu (%.4f MB)", numTriangles, triangleMemoryMB);
+    ImGui::Text("Triangles: %zu (%.4f MB, %zu-bit indices)", numTriangles, triangleMemoryMB, indexWidth * 8);
+    if (sphere.getVertexFormat() == VertexFormat::Octahedral)
+        ImGui::Text("Position error: %.2e (octahedral)", sphere.getPositionError());
+
+    ImGui::Text("Generation time: %.2f ms (%s)", sphere.getGenerationTime(), getMidpointKernelName());
+
+    UploadStats uploadStats = sphere.getUploadStats();
+    const char* uploadMethodNames[] = {"reallocate", "orphan", "persistent staging"};
+
+    ImGui::Text("Upload: %.3f ms for %.4f MB (%s, %zu reallocated, %.3f ms fence wait)",
+        uploadStats.time, static_cast<float>(uploadStats.bytes) / 1000.0f / 1000.0f,
+        uploadMethodNames[static_cast<int>(uploadStats.method)], uploadStats.reallocations, uploadStats.fenceWaitTime);
+
+    // The driver may defer the real work, so the whole frame shows the hitch better than the upload call
+    if (uploadFrameTime > 0.0)
+        ImGui::Text("Upload frame: %.2f ms (typical frame %.2f ms)", uploadFrameTime, typicalFrameTime);
+
+    if (generationWorker.isBusy())
+    {
+        std::string progressLabel = "Generating level " + std::to_string(generationWorker.getTarget().level);
+        ImGui::ProgressBar(generationWorker.getProgress(), ImVec2(200, 0), progressLabel.c_str());
+    }
+
+    // Compared to a uniform icosphere at the same level, which has 20 * 4^level triangles
+    if (type == SphereType::AdaptiveIcoSphere)
+    {
+        double uniformTriangles = 20.0 * std::pow(4.0, sphere.getSubdivisionLevel());
+        ImGui::Text("Adaptive: %.2f%% of uniform level %u", static_cast<double>(numTriangles) / uniformTriangles * 100.0, sphere.getSubdivisionLevel());
+    }
+
+    if (sphere.getClusterCulling())
+        ImGui::Text("Culled: %.1f%% of triangles (%zu meshlets)", sphere.getCulledFraction() * 100.0f, sphere.getMeshletCount());
+
+    if (sphere.getVertexCacheOptimization())
+    {
+        VertexCacheStats before = sphere.getCacheStatsBefore();
+        VertexCacheStats after = sphere.getCacheStatsAfter();
+
+        ImGui::Text("ACMR: %.3f -> %.3f", before.acmr, after.acmr);
+        ImGui::Text("ATVR: %.3f -> %.3f", before.atvr, after.atvr);
+        ImGui::Text("Optimization time: %.2f ms", sphere.getOptimizationTime());
+    }
+    ImGui::Text("Startup: %.2f ms to first frame (sphere %.3f ms)", firstFrameTime, startupSphereTime);
+
+    float cacheMemoryMB = static_cast<float>(sphere.getCacheUsedBytes()) / 1000.0f / 1000.0f;
+    ImGui::Text("Cached levels: %zu (%.4f MB)", sphere.getCachedLevelCount(), cacheMemoryMB);
+
+    ArenaStats scratchStats = sphere.getScratchStats();
+    ImGui::Text("Scratch: %zu spans from %zu heap blocks (peak %.4f MB of %.4f MB)",
+        scratchStats.allocationCount, scratchStats.heapAllocationCount,
+        static_cast<float>(scratchStats.peakBytes) / 1000.0f / 1000.0f,
+        static_cast<float>(scratchStats.capacityBytes) / 1000.0f / 1000.0f);
+
+    ArenaStats meshStats = sphere.getMeshStats();
+    ImGui::Text("Mesh: %zu spans from %zu heap blocks (peak %.4f MB of %.4f MB)",
+        meshStats.allocationCount, meshStats.heapAllocationCount,
+        static_cast<float>(meshStats.peakBytes) / 1000.0f / 1000.0f,
+        static_cast<float>(meshStats.capacityBytes) / 1000.0f / 1000.0f);
+
+    ImGui::NewLine();
+
+    ImGui::PushItemWidth(200);
+    ImGui::InputText("Mesh File", meshPath.data(), meshPath.size());
+    ImGui::PopItemWidth();
+
+    if (ImGui::Button("Save Mesh"))
+        sphere.save(meshPath.data());
+
+    ImGui::SameLine();
+
+    if (ImGui::Button("Load Mesh") && sphere.loadMapped(meshPath.data()))
+    {
+        generationWorker.cancel();
+        sphere.sendBufferData();
+    }
+
+    if (sphere.isMapped())
+    {
+        ImGui::SameLine();
+        ImGui::Text("(mapped)");
+    }
+
+    ImGui::NewLine();
+
+    // Copies of the current mesh drawn with one instanced call
+    ImGui::InputInt("Instances", &sceneInstanceCount, 1000, 100000);
+    sceneInstanceCount = std::max(sceneInstanceCount, 0);
+
+    if (ImGui::Button("Scatter"))
+        scene.scatter(sphere.getThreadPool(), 0, static_cast<size_t>(sceneInstanceCount), sceneExtent, sceneMinRadius, sceneMaxRadius);
+
+    ImGui::SameLine();
+
+    if (ImGui::Button("Clear Instances"))
+        scene.clear();
+
+    // Spinning changes every instance, so the buffer is packed and uploaded each frame
+    ImGui::Checkbox("Animate Instances", &animateScene);
+
+    // Only instances inside the view frustum are packed and drawn
+    bool sceneCulling = scene.getCulling();
+    if (ImGui::Checkbox("Cull Instances", &sceneCulling))
+        scene.setCulling(sceneCulling);
+
+    if (scene.getInstanceCount() > 0)
+    {
+        UploadStats sceneStats = scene.getUploadStats();
+
+        ImGui::Text("Instances: %zu (%.4f MB), upload %.3f ms with packing",
+            scene.getInstanceCount(), static_cast<float>(sceneStats.bytes) / 1000.0f / 1000.0f, scene.getUploadTime());
+
+        if (scene.getCulling())
+            ImGui::Text("Visible: %zu / %zu, cull %.3f ms", scene.getVisibleCount(), scene.getInstanceCount(), scene.getCullTime());
+
+        ImGui::Text("Frame: %.2f ms", typicalFrameTime);
+    }
+
+    ImGui::NewLine();
+
+    if (ImGui::Button("Measure Speedup"))
+        measureSpeedup();
+
+    for (size_t i = 0; i < speedupTimes.size(); i++)
+    {
+        if (speedupTimes[i] > 0.0)
+        {
+            ImGui::Text("%2u threads: %.2f ms (%.2fx)",
+                speedupThreadCounts[i], speedupTimes[i], speedupTimes[0] / speedupTimes[i]);
+        }
+    }
+
+    ImGui::NewLine();
+
+    bool taskTiming = sphere.getTaskTiming();
+    if (ImGui::Checkbox("Task Timing", &taskTiming))
+        sphere.setTaskTiming(taskTiming);
+
+    if (taskTiming)
+    {
+        std::vector<WorkerStats> workerStats = sphere.getWorkerStats();
+
+        double totalBusy = 0.0;
+        double maxBusy = 0.0;
+
+        for (size_t i = 0; i < workerStats.size(); i++)
+        {
+            ImGui::Text("Worker %2zu: %.2f ms in %zu tasks", i, workerStats[i].busyMilliseconds, workerStats[i].taskCount);
+
+            totalBusy += workerStats[i].busyMilliseconds;
+            maxBusy = std::max(maxBusy, workerStats[i].busyMilliseconds);
+        }
+
+        // 1 means every worker was busy for the same time
+        if (totalBusy > 0.0)
+            ImGui::Text("Imbalance: %.2fx (busiest / mean)", maxBusy / (totalBusy / static_cast<double>(workerStats.size())));
+
+        if (ImGui::Button("Reset Timing"))
+            sphere.resetWorkerStats();
+    }
 
     ImGui::PopItemWidth();
     ImGui::End();
@@ -359,9 +820,21 @@ void Application::draw()
     shader.setFloat("time", clock.getElapsedTime().asSeconds());
     shader.setBool("colorEnabled", colorful);
 
+    // The adaptive icosphere follows the camera, so it is refined and uploaded before culling
+    float viewportHeight = static_cast<float>(window.getSize().y);
+
+    if (sphere.updateAdaptive(view, projection, camera.getPosition(), viewportHeight))
+        sphere.sendBufferData();
+
     int modelLocation = shader.getLocation("model");
+    sphere.cullClusters(view, projection, camera.getPosition());
     sphere.render(shader, modelLocation);
 
+    // Instances use the same mesh, and only upload when they or the view changed since the last frame
+    scene.setFrustum(camera.getFrustumPlanes());
+    scene.upload(sphere.getThreadPool());
+    scene.render(shader);
+
     if (uiOpen)
     {
         window.pushGLStates();
@@ -395,4 +868,148 @@ void Application::updateUIState()
         mousePositionUI = sf::Mouse::getPosition(window);
         sf::Mouse::setPosition(windowCenter, window);
     }
+}
+
+void Application::requestMesh(const MeshKey& key)
+{
+    // Point spheres have no subdivision levels
+    if (key.type == SphereType::FibonacciSphere)
+        return;
+
+    // Deeper HEALPix orders overflow 32-bit pixel indices
+    if (key.type == SphereType::HEALPix && key.level > healpixMaxOrder)
+    {
+        MeshKey clamped = key;
+        clamped.level = healpixMaxOrder;
+
+        requestMesh(clamped);
+        return;
+    }
+
+    // Only the refinement limit changes, which is cheap
+    if (key.type == SphereType::AdaptiveIcoSphere)
+    {
+        generationWorker.cancel();
+        sphere.subdivide(key.level);
+        return;
+    }
+
+    if (key == sphere.getMeshKey())
+    {
+        generationWorker.cancel();
+        return;
+    }
+
+    // A cached level is a swap, everything else is built in the background
+    if (sphere.restoreCached(key))
+    {
+        generationWorker.cancel();
+        sphere.sendBufferData();
+        return;
+    }
+
+    generationWorker.request(key, sphere.getThreadCount());
+}
+
+MeshKey Application::getTargetKey() const
+{
+    if (generationWorker.isBusy())
+        return generationWorker.getTarget();
+
+    return sphere.getMeshKey();
+}
+
+void Application::measureSpeedup()
+{
+    unsigned int level = sphere.getSubdivisionLevel();
+
+    if (level == 0)
+        return;
+
+    // Timed on this thread, so a mesh arriving from the worker would get in the way
+    generationWorker.cancel();
+
+    unsigned int threadCount = sphere.getThreadCount();
+
+    for (size_t i = 0; i < speedupThreadCounts.size(); i++)
+    {
+        sphere.setThreadCount(speedupThreadCounts[i]);
+        sphere.regenerate();
+
+        speedupTimes[i] = sphere.getGenerationTime();
+    }
+
+    sphere.setThreadCount(threadCount);
+    sphere.sendBufferData();
+}
+
+void Application::measureBinning()
+{
+    std::vector<float> x(binningSamples);
+    std::vector<float> y(binningSamples);
+    std::vector<float> z(binningSamples);
+    std::vector<uint32_t> pixels(binningSamples);
+
+    // Normally distributed coordinates give uniformly distributed directions
+    std::mt19937 generator {};
+    std::normal_distribution<float> distribution {};
+
+    for (size_t i = 0; i < binningSamples; i++)
+    {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+
+    unsigned int order = sphere.getSubdivisionLevel();
+
+    auto startTime = std::chrono::steady_clock::now();
+    healpixVec2PixBatch(order, x.data(), y.data(), z.data(), binningSamples, pixels.data());
+    auto batchTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < binningSamples; i++)
+        pixels[i] = healpixVec2Pix(order, {x[i], y[i], z[i]});
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    binningTimes[0] = std::chrono::duration<double, std::milli>(batchTime - startTime).count();
+    binningTimes[1] = std::chrono::duration<double, std::milli>(endTime - batchTime).count();
+}
+
+void Application::compareWithIcosphere()
+{
+    // Icosphere level to compare at. The octahedron gets the segment count whose
+    // 8 * segments^2 triangles come closest to the 20 * 4^level of the icosphere
+    const unsigned int level = std::min(sphere.getSubdivisionLevel(), 9u);
+    const unsigned int segments = static_cast<unsigned int>(std::lround(std::ldexp(std::sqrt(2.5), static_cast<int>(level))));
+
+    MeshKey keys[2] {};
+    keys[0].type = SphereType::IcoSphere;
+    keys[0].mode = SubdivisionMode::Direct;
+    keys[0].level = level;
+
+    keys[1].type = SphereType::OctaSphere;
+    keys[1].mode = SubdivisionMode::Direct;
+    keys[1].resolution = segments;
+
+    for (size_t i = 0; i < shapeComparison.size(); i++)
+    {
+        Sphere reference {};
+        reference.setCacheBudget(0);
+        reference.setThreadCount(sphere.getThreadCount());
+        reference.generate(keys[i]);
+
+        // Best of a few runs, the first one also pays for allocating the mesh
+        double time = reference.getGenerationTime();
+
+        for (int run = 0; run < 3; run++)
+        {
+            reference.regenerate();
+            time = std::min(time, reference.getGenerationTime());
+        }
+
+        shapeComparison[i].triangles = reference.getTriangleCount();
+        shapeComparison[i].time = time;
+        shapeComparison[i].error = reference.measureSurfaceError();
+    }
 }
\ No newline at end of file
@@ -3,14 +3,18 @@
 #include <SFML/Graphics.hpp>
 #include <GL/glew.h>
 #include <string>
+#include <array>
 #include "camera.h"
 #include "sphere.h"
+#include "generation_worker.h"
+#include "sphere_scene.h"
 #include "imgui/imgui-SFML.h"
 
 class Application
 {
 public:
-	Application();
+	// Loads `startupMesh` from a .sphmesh file if given, otherwise starts with an icosphere
+	explicit Application(const std::string& startupMesh = "");
 	~Application();
 
 	void run();
@@ -22,8 +26,30 @@ public:
 
 	void updateUIState();
 
+	// Switches to the mesh for `key`, right away if it is cached and on the generation worker otherwise
+	void requestMesh(const MeshKey& key);
+	// Mesh the sphere is heading to, the pending request if there is one
+	MeshKey getTargetKey() const;
+
+	// Rebuilds the current subdivision level with each of the speedup thread counts
+	void measureSpeedup();
+
+	// Times binning random directions into HEALPix pixels at the current order, batched and one by one
+	void measureBinning();
+
+	// Builds an icosphere at the current level and an octahedron sphere with about as many
+	// triangles, and compares how fast they generate and how closely they follow the sphere
+	void compareWithIcosphere();
+
 private:
 	Sphere sphere {};
+	// Instances of the sphere mesh
+	SphereScene scene {};
+
+	GenerationWorker generationWorker {};
+	// Meshes coming back from the worker are swapped through these
+	std::vector<float> swapVertices {};
+	std::vector<unsigned int> swapIndices {};
 
 	sf::RenderWindow window {};
 	GLenum drawMode = GL_LINE;
@@ -45,8 +71,52 @@ private:
 	const int defaultSectors = 18;
 	const int defaultStacks = 18;
 
+	const int defaultFibonacciPoints = 100000;
+
+	const int defaultCacheBudgetMB = 256;
+
+	// Instances are scattered over a cube of this side, turning at sceneSpinSpeed radians per second
+	const float sceneExtent = 200.0f;
+	const float sceneMinRadius = 0.1f;
+	const float sceneMaxRadius = 0.5f;
+	const float sceneSpinSpeed = 1.0f;
+
 	float dt = 0.0f;
 
+	const std::array<unsigned int, 5> speedupThreadCounts {1, 2, 4, 8, 16};
+	std::array<double, 5> speedupTimes {};
+
+	const size_t binningSamples = 1 << 20;
+	std::array<double, 2> binningTimes {};
+
+	struct ShapeComparison
+	{
+		size_t triangles = 0;
+		double time = 0.0;
+		double error = 0.0;
+	};
+
+	std::array<ShapeComparison, 2> shapeComparison {};
+
+	int triangleBudget = 100000;
+	// In the units of the radius
+	float maxRadialError = 0.001f;
+	MeshEstimate meshFit {};
+	bool meshFitTried = false;
+
+	int sceneInstanceCount = 100000;
+	bool animateScene = false;
+
+	std::array<char, 256> meshPath {"sphere.sphmesh"};
+
+	double startupSphereTime = 0.0;
+	double firstFrameTime = 0.0;
+
+	// Length of the last frame with an upload in it, against an average of the frames without
+	size_t uploadCount = 0;
+	double uploadFrameTime = 0.0;
+	double typicalFrameTime = 0.0;
+
 	bool uiOpen = false;
 	sf::Vector2i mousePositionUI {defaultWidth / 2, defaultHeight / 2};
 
@@ -0,0 +1,75 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+// The first block, and the smallest one the arena grows by
+static constexpr size_t minimumBlockBytes = 64 * 1024;
+
+Arena::~Arena()
+{
+	releaseBlocks();
+}
+
+void* Arena::allocateBytes(size_t bytes)
+{
+	// Every span takes whole cache lines, which keeps the next one aligned
+	bytes = std::max<size_t>((bytes + alignment - 1) / alignment * alignment, alignment);
+
+	if (blocks.empty() || offset + bytes > blocks.back().capacity)
+		addBlock(bytes);
+
+	std::byte* span = blocks.back().data + offset;
+	offset += bytes;
+
+	stats.allocationCount++;
+	stats.usedBytes += bytes;
+	stats.peakBytes = std::max(stats.peakBytes, stats.usedBytes);
+
+	return span;
+}
+
+void Arena::reset()
+{
+	// Merging keeps the next round of the same allocations in a single block
+	if (blocks.size() > 1)
+	{
+		size_t capacity = stats.capacityBytes;
+
+		releaseBlocks();
+		addBlock(capacity);
+	}
+
+	offset = 0;
+	stats.usedBytes = 0;
+}
+
+ArenaStats Arena::getStats() const
+{
+	return stats;
+}
+
+void Arena::addBlock(size_t minimumBytes)
+{
+	// Growing geometrically keeps the number of blocks before the next merge small
+	size_t capacity = std::max({minimumBytes, minimumBlockBytes, stats.capacityBytes});
+
+	Block block {};
+	block.data = static_cast<std::byte*>(::operator new(capacity, std::align_val_t(alignment)));
+	block.capacity = capacity;
+
+	blocks.push_back(block);
+	offset = 0;
+
+	stats.heapAllocationCount++;
+	stats.capacityBytes += capacity;
+}
+
+void Arena::releaseBlocks()
+{
+	for (Block& block : blocks)
+		::operator delete(block.data, std::align_val_t(alignment));
+
+	blocks.clear();
+	stats.capacityBytes = 0;
+}
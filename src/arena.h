@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Allocation counters of an arena, for the stats panel
+struct ArenaStats
+{
+	// Spans handed out and heap blocks taken since the arena was created
+	size_t allocationCount = 0;
+	size_t heapAllocationCount = 0;
+	// Bytes in use now, the most ever in use at once, and the bytes held from the heap
+	size_t usedBytes = 0;
+	size_t peakBytes = 0;
+	size_t capacityBytes = 0;
+};
+
+// Bump allocator for buffers that only live until the next reset. Spans are 64-byte
+// aligned, so they start on a cache line and suit aligned SIMD loads. reset() releases
+// everything at once and keeps the capacity, so once the arena has grown to the largest
+// round of allocations it stops touching the heap
+class Arena
+{
+public:
+	static constexpr size_t alignment = 64;
+
+	Arena() = default;
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Returns `count` uninitialized elements, valid until the next reset
+	template <typename T>
+	std::span<T> allocate(size_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= alignment);
+
+		return {static_cast<T*>(allocateBytes(count * sizeof(T))), count};
+	}
+
+	void* allocateBytes(size_t bytes);
+
+	// Invalidates every span. A full arena that had to add blocks is merged into one block
+	// the size of all of them, otherwise this only moves the offset back to the start
+	void reset();
+
+	ArenaStats getStats() const;
+
+private:
+	struct Block
+	{
+		std::byte* data = nullptr;
+		size_t capacity = 0;
+	};
+
+	void addBlock(size_t minimumBytes);
+	void releaseBlocks();
+
+	std::vector<Block> blocks {};
+	// Offset into the last block
+	size_t offset = 0;
+
+	ArenaStats stats {};
+};
+
+// Standard allocator over an Arena. Freeing does nothing, the memory comes back when the
+// arena is reset, so containers using it have to let go of their storage before that
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator(Arena& arena)
+		: arena(&arena)
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other)
+		: arena(other.arena)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return arena->allocate<T>(count).data();
+	}
+
+	void deallocate(T*, size_t)
+	{
+	}
+
+	bool operator==(const ArenaAllocator& other) const
+	{
+		return arena == other.arena;
+	}
+
+private:
+	template <typename U>
+	friend class ArenaAllocator;
+
+	Arena* arena = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
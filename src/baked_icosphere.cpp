@@ -0,0 +1,202 @@
+#include "baked_icosphere.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace
+{
+	template <unsigned int Level>
+	struct IcosphereLevel
+	{
+		// Every level keeps the previous vertices and adds one per edge, 10 * 4^n + 2 in total
+		static constexpr size_t vertexCount = 10 * (static_cast<size_t>(1) << (2 * Level)) + 2;
+		static constexpr size_t triangleCount = 20 * (static_cast<size_t>(1) << (2 * Level));
+
+		std::array<float, vertexCount * 3> vertices {};
+		std::array<unsigned int, triangleCount * 3> indices {};
+	};
+
+	// Newton's method converges from any starting point above the root, so this stops
+	// once the estimate no longer decreases
+	constexpr double bakedSqrt(double x)
+	{
+		double root = x > 1.0 ? x : 1.0;
+
+		for (int i = 0; i < 128; i++)
+		{
+			double next = 0.5 * (root + x / root);
+
+			if (next >= root)
+				break;
+
+			root = next;
+		}
+
+		return root;
+	}
+
+	// Correctly rounded, like std::sqrt. The double estimate is close, and the neighbouring floats
+	// are checked exactly: midpoints between floats have 25 significant bits, so their squares fit in a double
+	constexpr float bakedSqrtFloat(float x)
+	{
+		auto step = [](float value, uint32_t offset)
+		{
+			return std::bit_cast<float>(std::bit_cast<uint32_t>(value) + offset);
+		};
+
+		auto midpointSquared = [](float a, float b)
+		{
+			double midpoint = (static_cast<double>(a) + static_cast<double>(b)) * 0.5;
+			return midpoint * midpoint;
+		};
+
+		float root = static_cast<float>(bakedSqrt(static_cast<double>(x)));
+
+		while (x > midpointSquared(root, step(root, 1)))
+			root = step(root, 1);
+
+		while (root > 0.0f && x < midpointSquared(root, step(root, ~0u)))
+			root = step(root, ~0u);
+
+		return root;
+	}
+
+	consteval IcosphereLevel<0> bakeBase()
+	{
+		// Source: https://en.wikipedia.org/wiki/Regular_icosahedron#Construction
+		const double phi = (1.0 + bakedSqrt(5.0)) / 2.0;
+		const double scale = 1.0 / bakedSqrt(phi * phi + 1.0);
+		const double scaledPhi = phi * scale;
+
+		const double positions[12][3] {
+			{-scale, scaledPhi, 0}, {scale, scaledPhi, 0}, {-scale, -scaledPhi, 0}, {scale, -scaledPhi, 0},
+			{0, -scale, scaledPhi}, {0, scale, scaledPhi}, {0, -scale, -scaledPhi}, {0, scale, -scaledPhi},
+			{scaledPhi, 0, -scale}, {scaledPhi, 0, scale}, {-scaledPhi, 0, -scale}, {-scaledPhi, 0, scale}};
+
+		IcosphereLevel<0> level {};
+
+		for (size_t i = 0; i < 12; i++)
+		{
+			for (size_t axis = 0; axis < 3; axis++)
+				level.vertices[i * 3 + axis] = static_cast<float>(positions[i][axis]);
+		}
+
+		level.indices = {
+			0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+			1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+			3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+			4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+
+		return level;
+	}
+
+	// Mirrors Sphere::subdivideShared: midpoints get indices in the order their edges are
+	// first met, so the runtime can continue subdividing from a baked level
+	template <unsigned int Level>
+	consteval IcosphereLevel<Level> bakeLevel()
+	{
+		if constexpr (Level == 0)
+		{
+			return bakeBase();
+		}
+		else
+		{
+			using Previous = IcosphereLevel<Level - 1>;
+
+			const Previous previous = bakeLevel<Level - 1>();
+			IcosphereLevel<Level> level {};
+
+			for (size_t i = 0; i < Previous::vertexCount * 3; i++)
+				level.vertices[i] = previous.vertices[i];
+
+			// Every vertex has at most 6 neighbours, so the edges of each vertex fit in a small fixed table
+			struct Edge
+			{
+				unsigned int other = 0;
+				unsigned int midpoint = 0;
+			};
+
+			std::array<std::array<Edge, 6>, Previous::vertexCount> edges {};
+			std::array<unsigned int, Previous::vertexCount> edgeCounts {};
+
+			unsigned int nextVertex = static_cast<unsigned int>(Previous::vertexCount);
+
+			auto addMidpoint = [&](unsigned int a, unsigned int b) -> unsigned int
+			{
+				unsigned int low = a < b ? a : b;
+				unsigned int high = a < b ? b : a;
+
+				for (unsigned int k = 0; k < edgeCounts[low]; k++)
+				{
+					if (edges[low][k].other == high)
+						return edges[low][k].midpoint;
+				}
+
+				// The float operations of the scalar midpoint kernel in the same order. The vector kernels
+				// use rsqrt, which can't be evaluated at compile time, and land within a few ulps of this
+				float midpoint[3] {};
+
+				for (size_t axis = 0; axis < 3; axis++)
+					midpoint[axis] = (level.vertices[a * 3 + axis] + level.vertices[b * 3 + axis]) * 0.5f;
+
+				const float lengthSquared = (midpoint[0] * midpoint[0] + midpoint[1] * midpoint[1]) + midpoint[2] * midpoint[2];
+				const float scale = 1.0f / bakedSqrtFloat(lengthSquared);
+
+				for (size_t axis = 0; axis < 3; axis++)
+					level.vertices[nextVertex * 3 + axis] = midpoint[axis] * scale;
+
+				edges[low][edgeCounts[low]++] = {high, nextVertex};
+
+				return nextVertex++;
+			};
+
+			for (size_t j = 0; j < Previous::triangleCount; j++)
+			{
+				unsigned int v1 = previous.indices[j * 3];
+				unsigned int v2 = previous.indices[j * 3 + 1];
+				unsigned int v3 = previous.indices[j * 3 + 2];
+
+				unsigned int mid1 = addMidpoint(v1, v2);
+				unsigned int mid2 = addMidpoint(v2, v3);
+				unsigned int mid3 = addMidpoint(v3, v1);
+
+				const unsigned int triangles[12] {v1, mid1, mid3, mid1, v2, mid2, mid3, mid2, v3, mid1, mid2, mid3};
+
+				for (size_t k = 0; k < 12; k++)
+					level.indices[j * 12 + k] = triangles[k];
+			}
+
+			return level;
+		}
+	}
+
+	constexpr IcosphereLevel<0> level0 = bakeLevel<0>();
+	constexpr IcosphereLevel<1> level1 = bakeLevel<1>();
+	constexpr IcosphereLevel<2> level2 = bakeLevel<2>();
+	constexpr IcosphereLevel<3> level3 = bakeLevel<3>();
+
+	static_assert(bakedIcosphereLevels == 4, "Every baked level needs a table above");
+
+	template <unsigned int Level>
+	BakedIcosphere describe(const IcosphereLevel<Level>& level)
+	{
+		return {level.vertices.data(), IcosphereLevel<Level>::vertexCount,
+			level.indices.data(), IcosphereLevel<Level>::triangleCount};
+	}
+}
+
+BakedIcosphere getBakedIcosphere(unsigned int level)
+{
+	switch (level)
+	{
+	case 0:
+		return describe(level0);
+	case 1:
+		return describe(level1);
+	case 2:
+		return describe(level2);
+	default:
+		return describe(level3);
+	}
+}
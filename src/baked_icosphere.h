@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Icosphere levels below this are generated at compile time and stored in the binary
+constexpr unsigned int bakedIcosphereLevels = 4;
+
+// Vertex and index data of one baked level, in the same layout shared vertex subdivision produces
+struct BakedIcosphere
+{
+	const float* vertices = nullptr;
+	size_t vertexCount = 0;
+
+	const unsigned int* indices = nullptr;
+	size_t triangleCount = 0;
+};
+
+// `level` must be below bakedIcosphereLevels
+BakedIcosphere getBakedIcosphere(unsigned int level);
@@ -0,0 +1,232 @@
+#include "buffer_upload.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// Staging memory starts at this size and grows in powers of two up to the limit.
+// Bigger uploads are orphaned instead of taking as much memory again for staging
+static constexpr size_t minStagingBytes = size_t {1} << 20;
+static constexpr size_t maxStagingBytes = size_t {256} << 20;
+
+// Each upload starts its staging range on a cache line
+static constexpr size_t stagingAlignment = 64;
+
+// Copies into staging memory are split into tasks of this many bytes
+static constexpr size_t copyChunkBytes = size_t {1} << 20;
+
+// Waits on a fence in steps of this many nanoseconds
+static constexpr GLuint64 fenceTimeout = 1000000;
+
+static size_t alignStaging(size_t offset)
+{
+	return (offset + stagingAlignment - 1) & ~(stagingAlignment - 1);
+}
+
+void BufferUploader::setMethod(UploadMethod newMethod)
+{
+	method = newMethod;
+}
+
+UploadMethod BufferUploader::getMethod() const
+{
+	return method;
+}
+
+void BufferUploader::begin(size_t totalBytes)
+{
+	startTime = std::chrono::steady_clock::now();
+
+	stats.bytes = 0;
+	stats.fenceWaitTime = 0.0;
+	stats.reallocations = 0;
+
+	activeMethod = method;
+
+	if (method == UploadMethod::PersistentStaging && !(stagingAvailable() && reserveStaging(totalBytes)))
+		activeMethod = UploadMethod::Orphan;
+}
+
+void BufferUploader::upload(ThreadPool& threadPool, unsigned int target, unsigned int buffer, size_t& capacity, const void* data, size_t bytes)
+{
+	stats.bytes += bytes;
+
+	glBindBuffer(target, buffer);
+
+	if (activeMethod == UploadMethod::Reallocate)
+	{
+		glBufferData(target, static_cast<GLsizeiptr>(bytes), data, GL_STATIC_DRAW);
+
+		capacity = bytes;
+		stats.reallocations++;
+		return;
+	}
+
+	// More than begin was told about goes the orphaning way
+	bool staged = activeMethod == UploadMethod::PersistentStaging && rangeOffset + bytes <= rangeEnd;
+
+	if (bytes > capacity)
+	{
+		// Staged data is copied in below, into the storage made here
+		glBufferData(target, static_cast<GLsizeiptr>(bytes), staged ? nullptr : data, GL_STATIC_DRAW);
+
+		capacity = bytes;
+		stats.reallocations++;
+
+		if (!staged)
+			return;
+	}
+	else if (!staged)
+	{
+		// Orphaning at the same size lets the driver recycle memory no draw is using anymore,
+		// and the write then never has to wait for the GPU
+		glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr, GL_STATIC_DRAW);
+		glBufferSubData(target, 0, static_cast<GLsizeiptr>(bytes), data);
+		return;
+	}
+
+	std::byte* destination = stagingMemory + rangeOffset;
+	const std::byte* source = static_cast<const std::byte*>(data);
+
+	threadPool.parallelFor((bytes + copyChunkBytes - 1) / copyChunkBytes, [&](size_t begin, size_t end)
+	{
+		size_t first = begin * copyChunkBytes;
+		size_t last = std::min(end * copyChunkBytes, bytes);
+
+		std::memcpy(destination + first, source + first, last - first);
+	});
+
+	// The copy runs on the GPU after any earlier draws from the old contents, so nothing waits here
+	glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, target,
+		static_cast<GLintptr>(rangeOffset), 0, static_cast<GLsizeiptr>(bytes));
+
+	rangeOffset += bytes;
+}
+
+void BufferUploader::end()
+{
+	if (activeMethod == UploadMethod::PersistentStaging && rangeEnd > rangeBegin)
+	{
+		pendingRanges.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), rangeBegin, rangeEnd});
+		stagingHead = rangeEnd;
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+
+	stats.method = activeMethod;
+	stats.time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	stats.uploadCount++;
+}
+
+UploadStats BufferUploader::getStats() const
+{
+	return stats;
+}
+
+bool BufferUploader::stagingAvailable()
+{
+	// Buffer storage is core from OpenGL 4.4, the context asks for 4.3
+	if (stagingSupport < 0)
+		stagingSupport = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4 ? 1 : 0;
+
+	return stagingSupport == 1;
+}
+
+bool BufferUploader::reserveStaging(size_t bytes)
+{
+	if (bytes > maxStagingBytes)
+		return false;
+
+	if (bytes > stagingCapacity)
+	{
+		// The old buffer goes away, so every copy from it has to finish first
+		for (const StagingRange& range : pendingRanges)
+		{
+			stats.fenceWaitTime += waitFence(range.fence);
+			glDeleteSync(range.fence);
+		}
+
+		pendingRanges.clear();
+
+		// Deleting a buffer also unmaps it
+		if (stagingBuffer != 0)
+			glDeleteBuffers(1, &stagingBuffer);
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		stagingCapacity = std::max(std::bit_ceil(bytes), minStagingBytes);
+		stagingHead = 0;
+
+		glGenBuffers(1, &stagingBuffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+		glBufferStorage(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(stagingCapacity), nullptr, flags);
+
+		stagingMemory = static_cast<std::byte*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(stagingCapacity), flags));
+
+		// A driver that can't map it won't do better next time
+		if (stagingMemory == nullptr)
+		{
+			glDeleteBuffers(1, &stagingBuffer);
+
+			stagingBuffer = 0;
+			stagingCapacity = 0;
+			stagingSupport = 0;
+			return false;
+		}
+	}
+
+	size_t begin = alignStaging(stagingHead);
+
+	if (begin + bytes > stagingCapacity)
+		begin = 0;
+
+	auto overlaps = [&](const StagingRange& range)
+	{
+		return range.begin < begin + bytes && begin < range.end;
+	};
+
+	// Fences pass in order, so waiting on the newest overlapping range frees all older ones too
+	auto newest = std::find_if(pendingRanges.rbegin(), pendingRanges.rend(), overlaps);
+
+	if (newest != pendingRanges.rend())
+	{
+		stats.fenceWaitTime += waitFence(newest->fence);
+
+		size_t passed = static_cast<size_t>(pendingRanges.rend() - newest);
+
+		for (size_t i = 0; i < passed; i++)
+		{
+			glDeleteSync(pendingRanges.front().fence);
+			pendingRanges.pop_front();
+		}
+	}
+
+	rangeBegin = begin;
+	rangeOffset = begin;
+	rangeEnd = begin + bytes;
+
+	return true;
+}
+
+double BufferUploader::waitFence(__GLsync* fence)
+{
+	auto waitStart = std::chrono::steady_clock::now();
+
+	// Flushes on the first try so the fence is sure to be reached
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+	while (true)
+	{
+		GLenum result = glClientWaitSync(fence, flags, fenceTimeout);
+
+		if (result != GL_TIMEOUT_EXPIRED)
+			break;
+
+		flags = 0;
+	}
+
+	auto waitEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include "thread_pool.h"
+
+// Same type as GLsync, declared here to keep the OpenGL headers out
+struct __GLsync;
+
+enum class UploadMethod
+{
+	// glBufferData on every upload, which reallocates the storage each time
+	Reallocate,
+	// Keeps the storage when the data fits and orphans it first, so the driver can hand back
+	// fresh memory instead of waiting for draws still reading the old contents
+	Orphan,
+	// Writes into a persistently mapped staging buffer and copies on the GPU. Needs ARB_buffer_storage,
+	// falls back to Orphan without it
+	PersistentStaging
+};
+
+struct UploadStats
+{
+	// Method the last upload actually used
+	UploadMethod method {};
+	size_t bytes = 0;
+	// CPU time of the last upload in milliseconds, and the part of it spent waiting on staging fences
+	double time = 0.0;
+	double fenceWaitTime = 0.0;
+	// Buffers the last upload had to give new storage
+	size_t reallocations = 0;
+	size_t uploadCount = 0;
+};
+
+// Fills vertex and index buffers, reusing their storage where the new data fits.
+// Buffers track the size of their storage in a capacity the caller keeps next to them
+class BufferUploader
+{
+public:
+	BufferUploader() = default;
+
+	void setMethod(UploadMethod method);
+	UploadMethod getMethod() const;
+
+	// Starts an upload of at most `totalBytes` over one or more buffers. Only waits for the GPU
+	// if the staging memory it needs is still being copied from by an earlier upload
+	void begin(size_t totalBytes);
+	// Fills `buffer` with `bytes` bytes of `data`, leaving it bound to `target`.
+	// `capacity` is the size of its storage in bytes and grows when the data doesn't fit
+	void upload(ThreadPool& threadPool, unsigned int target, unsigned int buffer, size_t& capacity, const void* data, size_t bytes);
+	// Fences the staging memory written since begin
+	void end();
+
+	UploadStats getStats() const;
+
+private:
+	// Staging memory handed out by begin, and fenced by end
+	struct StagingRange
+	{
+		__GLsync* fence = nullptr;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	bool stagingAvailable();
+	// Reserves the range for `bytes` bytes of staging memory after stagingHead, returns false if it can't
+	bool reserveStaging(size_t bytes);
+	// Blocks until the fence has passed and returns the time spent in milliseconds
+	double waitFence(__GLsync* fence);
+
+	UploadMethod method = UploadMethod::PersistentStaging;
+	// Method of the upload in progress, after any fallback
+	UploadMethod activeMethod = UploadMethod::Orphan;
+
+	// -1 until the extension has been checked, which needs a context
+	int stagingSupport = -1;
+
+	unsigned int stagingBuffer = 0;
+	std::byte* stagingMemory = nullptr;
+	size_t stagingCapacity = 0;
+
+	// Staging is used as a ring. The upload in progress writes [rangeBegin, rangeEnd) starting at
+	// rangeOffset, while earlier ranges stay reserved until their copies have run
+	size_t stagingHead = 0;
+	size_t rangeBegin = 0;
+	size_t rangeOffset = 0;
+	size_t rangeEnd = 0;
+	std::deque<StagingRange> pendingRanges {};
+
+	UploadStats stats {};
+	std::chrono::steady_clock::time_point startTime {};
+};
@@ -97,6 +97,8 @@ void Camera::update()
 
 	view = glm::lookAt(position, position + direction, up);
 	projection = glm::perspective(glm::radians(fov), aspectRatio, minRange, maxRange);
+
+	frustumPlanes = extractFrustumPlanes(projection * view);
 }
 
 glm::mat4 Camera::getViewMatrix() const
@@ -109,6 +111,11 @@ glm::mat4 Camera::getProjectionMatrix() const
 	return projection;
 }
 
+const std::array<glm::vec4, 6>& Camera::getFrustumPlanes() const
+{
+	return frustumPlanes;
+}
+
 void Camera::updateCameraVectors()
 {
 	// Update direction vector
@@ -121,4 +128,23 @@ void Camera::updateCameraVectors()
 	// Recalculate right and up vectors
 	right = glm::normalize(glm::cross(direction, worldUp));
 	up = glm::normalize(glm::cross(right, direction));
+}
+
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& clip)
+{
+	// Sums and differences of the rows of the clip matrix (Gribb and Hartmann)
+	glm::vec4 rows[4] {};
+
+	for (int row = 0; row < 4; row++)
+		rows[row] = {clip[0][row], clip[1][row], clip[2][row], clip[3][row]};
+
+	std::array<glm::vec4, 6> planes {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2]};
+
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return planes;
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <array>
+
+// Planes (a, b, c, d) of the frustum of a clip matrix, in the space the matrix transforms from,
+// ordered left, right, bottom, top, near, far. Normals are unit length and point inwards, so a point p
+// is inside when dot(abc, p) + d >= 0 for all six
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& clip);
 
 class Camera
 {
@@ -33,6 +39,9 @@ public:
 	glm::mat4 getViewMatrix() const;
 	glm::mat4 getProjectionMatrix() const;
 
+	// World space planes of the view frustum as of the last update, laid out as by extractFrustumPlanes
+	const std::array<glm::vec4, 6>& getFrustumPlanes() const;
+
 private:
 	void updateCameraVectors();
 
@@ -50,6 +59,8 @@ private:
 	glm::mat4 view {};
 	glm::mat4 projection {};
 
+	std::array<glm::vec4, 6> frustumPlanes {};
+
 	float aspectRatio = 1.0f;
 	float fov = 90.0f;
 	float minRange = 0.1f;
@@ -0,0 +1,39 @@
+#include "cpu_features.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static bool detectAVX2()
+{
+#ifndef CPU_FEATURES_X86
+	return false;
+#elif defined(_MSC_VER)
+	int info[4] {};
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+		return false;
+
+	// AVX support in the CPU and YMM state saving enabled by the OS
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuSupportsAVX2()
+{
+	static const bool supported = detectAVX2();
+	return supported;
+}
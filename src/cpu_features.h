@@ -0,0 +1,15 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_FEATURES_X86 1
+#endif
+
+// Lets a single function use AVX2 without building the whole program for it
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// True if both the CPU and the OS support AVX2, detected on first use
+bool cpuSupportsAVX2();
@@ -0,0 +1,106 @@
+#include "fibonacci_sphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+static constexpr double goldenRatio = std::numbers::phi;
+static constexpr double twoPi = 2.0 * std::numbers::pi;
+
+// Fractional part of a * b. Angles are kept in double until this point, since
+// i * golden ratio loses the fraction in float beyond a few million points
+static double fractionalProduct(double a, double b)
+{
+	double product = a * b;
+	return product - std::floor(product);
+}
+
+glm::vec3 getFibonacciPoint(size_t index, size_t count)
+{
+	const double n = static_cast<double>(count);
+	const double i = static_cast<double>(index);
+
+	const double y = 1.0 - (2.0 * i + 1.0) / n;
+	const double radius = std::sqrt(std::max(1.0 - y * y, 0.0));
+	const double angle = twoPi * fractionalProduct(i, goldenRatio - 1.0);
+
+	return {
+		static_cast<float>(radius * std::cos(angle)),
+		static_cast<float>(y),
+		static_cast<float>(radius * std::sin(angle))};
+}
+
+void generateFibonacciPoints(ThreadPool& threadPool, size_t count, float* vertices)
+{
+	threadPool.parallelFor(count, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 point = getFibonacciPoint(i, count);
+
+			vertices[i * 3] = point.x;
+			vertices[i * 3 + 1] = point.y;
+			vertices[i * 3 + 2] = point.z;
+		}
+	});
+}
+
+size_t findNearestFibonacciPoint(const glm::vec3& direction, size_t count)
+{
+	if (count <= 1)
+		return 0;
+
+	const double n = static_cast<double>(count);
+	const double pi = std::numbers::pi;
+
+	const double phi = std::min(std::atan2(static_cast<double>(direction.z), static_cast<double>(direction.x)), pi);
+	const double cosTheta = std::clamp(static_cast<double>(direction.y), -1.0, 1.0);
+
+	// Near the point, the lattice is spanned by the two neighbours whose index differs by
+	// consecutive Fibonacci numbers F(k) and F(k + 1), with k picked from the local point spacing
+	const double zone = std::log(n * pi * std::sqrt(5.0) * (1.0 - cosTheta * cosTheta)) / std::log(goldenRatio * goldenRatio);
+	const double k = std::max(2.0, std::floor(zone));
+
+	const double fibonacciK = std::round(std::pow(goldenRatio, k) / std::sqrt(5.0));
+	const double fibonacciK1 = std::round(std::pow(goldenRatio, k + 1.0) / std::sqrt(5.0));
+
+	// Basis vectors of the local lattice in (phi, cos theta)
+	const double basisPhi0 = twoPi * fractionalProduct(fibonacciK + 1.0, goldenRatio - 1.0) - twoPi * (goldenRatio - 1.0);
+	const double basisPhi1 = twoPi * fractionalProduct(fibonacciK1 + 1.0, goldenRatio - 1.0) - twoPi * (goldenRatio - 1.0);
+	const double basisZ0 = -2.0 * fibonacciK / n;
+	const double basisZ1 = -2.0 * fibonacciK1 / n;
+
+	// Lattice cell that contains the direction, from the inverse of the basis
+	const double determinant = basisPhi0 * basisZ1 - basisPhi1 * basisZ0;
+	const double offsetZ = cosTheta - (1.0 - 1.0 / n);
+
+	const double cell0 = std::floor((basisZ1 * phi - basisPhi1 * offsetZ) / determinant);
+	const double cell1 = std::floor((basisPhi0 * offsetZ - basisZ0 * phi) / determinant);
+
+	// The nearest point is one of the four corners of that cell
+	double bestDistance = std::numeric_limits<double>::max();
+	size_t bestIndex = 0;
+
+	for (int corner = 0; corner < 4; corner++)
+	{
+		double z = basisZ0 * (cell0 + (corner & 1)) + basisZ1 * (cell1 + (corner >> 1)) + (1.0 - 1.0 / n);
+
+		// Corners past a pole are reflected back onto the sphere
+		z = std::clamp(z, -1.0, 1.0) * 2.0 - z;
+
+		double index = std::floor(n * 0.5 - z * n * 0.5);
+		index = std::clamp(index, 0.0, n - 1.0);
+
+		glm::vec3 point = getFibonacciPoint(static_cast<size_t>(index), count);
+		double distance = glm::dot(point - direction, point - direction);
+
+		if (distance < bestDistance)
+		{
+			bestDistance = distance;
+			bestIndex = static_cast<size_t>(index);
+		}
+	}
+
+	return bestIndex;
+}
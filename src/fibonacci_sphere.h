@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "thread_pool.h"
+
+// Spherical Fibonacci lattice: point i of n sits at height y = 1 - (2i + 1) / n and turns
+// by the golden angle from the one before, which spreads any number of points almost evenly.
+// The y axis is the polar axis, as for the sector sphere
+
+// Direction of point `index` out of `count`
+glm::vec3 getFibonacciPoint(size_t index, size_t count);
+
+// Writes all `count` points to `vertices` as xyz triples. Every point only depends on its
+// index, so the loop has no carried state and splits into ranges freely
+void generateFibonacciPoints(ThreadPool& threadPool, size_t count, float* vertices);
+
+// Index of the point closest to `direction` in constant time, by inverting the lattice locally
+// (Keinert et al., "Spherical Fibonacci Mapping", 2015). `direction` must be normalized
+size_t findNearestFibonacciPoint(const glm::vec3& direction, size_t count);
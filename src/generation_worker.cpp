@@ -0,0 +1,130 @@
+#include "generation_worker.h"
+
+GenerationWorker::GenerationWorker()
+{
+	// The worker only keeps its last mesh until it is handed over, so it has no level cache
+	sphere.setCacheBudget(0);
+
+	thread = std::thread(&GenerationWorker::workerLoop, this);
+}
+
+GenerationWorker::~GenerationWorker()
+{
+	{
+		std::lock_guard lock(mutex);
+
+		stopping = true;
+		requestId++;
+	}
+
+	wakeCondition.notify_one();
+	thread.join();
+}
+
+void GenerationWorker::request(const MeshKey& key, unsigned int threadCount)
+{
+	{
+		std::lock_guard lock(mutex);
+
+		target = key;
+		targetThreadCount = threadCount;
+		pending = true;
+		busy = true;
+
+		// A result for an older request is no longer wanted
+		resultReady = false;
+		progress = 0.0f;
+		requestId++;
+	}
+
+	wakeCondition.notify_one();
+}
+
+void GenerationWorker::cancel()
+{
+	std::lock_guard lock(mutex);
+
+	pending = false;
+	busy = false;
+	resultReady = false;
+	requestId++;
+}
+
+bool GenerationWorker::takeResult(MeshKey& key, std::vector<float>& vertices, std::vector<unsigned int>& indices, double& generationTime)
+{
+	std::lock_guard lock(mutex);
+
+	if (!resultReady)
+		return false;
+
+	key = resultKey;
+	vertices.swap(resultVertices);
+	indices.swap(resultIndices);
+	generationTime = resultTime;
+
+	resultReady = false;
+	busy = false;
+
+	return true;
+}
+
+bool GenerationWorker::isBusy() const
+{
+	std::lock_guard lock(mutex);
+	return busy;
+}
+
+MeshKey GenerationWorker::getTarget() const
+{
+	std::lock_guard lock(mutex);
+	return target;
+}
+
+float GenerationWorker::getProgress() const
+{
+	return progress;
+}
+
+void GenerationWorker::workerLoop()
+{
+	std::unique_lock lock(mutex);
+
+	while (true)
+	{
+		wakeCondition.wait(lock, [this] { return stopping || pending; });
+
+		if (stopping)
+			return;
+
+		const MeshKey key = target;
+		const unsigned int threadCount = targetThreadCount;
+		const uint64_t id = requestId;
+		pending = false;
+
+		lock.unlock();
+
+		sphere.setThreadCount(threadCount);
+		sphere.setProgressCallback([this, id](float fraction)
+		{
+			if (requestId != id)
+				return false;
+
+			progress = fraction;
+			return true;
+		});
+
+		bool finished = sphere.generate(key);
+
+		lock.lock();
+
+		// Requests that arrived during the build have already dropped this one
+		if (finished && requestId == id)
+		{
+			resultKey = key;
+			sphere.releaseMesh(resultVertices, resultIndices);
+			resultTime = sphere.getGenerationTime();
+			resultReady = true;
+			progress = 1.0f;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sphere.h"
+
+// Builds meshes on a background thread while the render thread keeps drawing the current one.
+// Only the latest request matters: a new request cancels the one in progress, and the
+// finished mesh is handed to the render thread through takeResult
+class GenerationWorker
+{
+public:
+	GenerationWorker();
+	~GenerationWorker();
+
+	GenerationWorker(const GenerationWorker&) = delete;
+	GenerationWorker& operator=(const GenerationWorker&) = delete;
+
+	// Replaces any earlier request, which is cancelled at its next subdivision pass
+	void request(const MeshKey& key, unsigned int threadCount);
+	// Drops the current request, for when the mesh is changed directly
+	void cancel();
+
+	// Swaps the finished mesh of the latest request out. Returns false if it isn't done yet
+	bool takeResult(MeshKey& key, std::vector<float>& vertices, std::vector<unsigned int>& indices, double& generationTime);
+
+	// True from a request until its result is taken or it is cancelled
+	bool isBusy() const;
+	// Key of the latest request
+	MeshKey getTarget() const;
+	// Fraction of the latest request done so far
+	float getProgress() const;
+
+private:
+	void workerLoop();
+
+	// Only ever touched by the worker thread, so it keeps the last cancelled
+	// level to continue from
+	Sphere sphere {};
+
+	std::thread thread {};
+
+	mutable std::mutex mutex {};
+	std::condition_variable wakeCondition {};
+
+	MeshKey target {};
+	unsigned int targetThreadCount = 0;
+	bool pending = false;
+	bool busy = false;
+	bool stopping = false;
+
+	// Bumped by every request and cancel, a build stops once it no longer matches
+	std::atomic<uint64_t> requestId = 0;
+	std::atomic<float> progress = 0.0f;
+
+	bool resultReady = false;
+	MeshKey resultKey {};
+	std::vector<float> resultVertices {};
+	std::vector<unsigned int> resultIndices {};
+	double resultTime = 0.0;
+};
@@ -0,0 +1,478 @@
+#include "healpix.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+// Ring of the southern corner of each base face in units of nside, counted from the north pole,
+// and the longitude of its center in units of pi / 4
+static constexpr int faceRing[12] = {2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
+static constexpr int facePhi[12] = {1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7};
+
+static constexpr double quarterPi = std::numbers::pi / 4.0;
+static constexpr double halfPi = std::numbers::pi / 2.0;
+
+// Point on the sphere by the cosine and sine of its colatitude and its longitude
+struct HealpixLocation
+{
+	double z;
+	double sinTheta;
+	double phi;
+};
+
+// Moves the low 16 bits of `v` to the even bits
+static uint32_t spreadBits(uint32_t v)
+{
+	v = (v | (v << 8)) & 0x00FF00FFu;
+	v = (v | (v << 4)) & 0x0F0F0F0Fu;
+	v = (v | (v << 2)) & 0x33333333u;
+	v = (v | (v << 1)) & 0x55555555u;
+	return v;
+}
+
+static uint32_t compactBits(uint32_t v)
+{
+	v &= 0x55555555u;
+	v = (v | (v >> 1)) & 0x33333333u;
+	v = (v | (v >> 2)) & 0x0F0F0F0Fu;
+	v = (v | (v >> 4)) & 0x00FF00FFu;
+	v = (v | (v >> 8)) & 0x0000FFFFu;
+	return v;
+}
+
+static uint32_t toPixel(unsigned int order, uint32_t ix, uint32_t iy, uint32_t face)
+{
+	return (face << (2 * order)) | spreadBits(ix) | (spreadBits(iy) << 1);
+}
+
+// Location of the point (x, y) in [0, 1]^2 on base face `face`, where x runs to the east
+// corner and y to the west corner
+static HealpixLocation faceToLocation(double x, double y, int face)
+{
+	const double ring = faceRing[face] - x - y;
+
+	HealpixLocation location {};
+	double ringWidth = 1.0;
+
+	if (ring < 1.0 || ring > 3.0)
+	{
+		// Polar caps, where the rings shrink towards the pole
+		ringWidth = ring < 1.0 ? ring : 4.0 - ring;
+
+		double t = ringWidth * ringWidth / 3.0;
+		location.z = ring < 1.0 ? 1.0 - t : t - 1.0;
+		location.sinTheta = std::sqrt(t * (2.0 - t));
+	}
+	else
+	{
+		location.z = (2.0 - ring) * 2.0 / 3.0;
+		location.sinTheta = std::sqrt((1.0 - location.z) * (1.0 + location.z));
+	}
+
+	double t = facePhi[face] * ringWidth + x - y;
+
+	if (t < 0.0)
+		t += 8.0;
+	else if (t >= 8.0)
+		t -= 8.0;
+
+	location.phi = ringWidth < 1e-15 ? 0.0 : quarterPi * t / ringWidth;
+
+	return location;
+}
+
+static uint32_t locationToPixel(unsigned int order, double z, double sinTheta, double phi)
+{
+	const int64_t nside = int64_t {1} << order;
+	const int64_t mask = nside - 1;
+	const double za = std::abs(z);
+
+	// Longitude in quarter turns, in [0, 4)
+	double tt = std::fmod(phi / halfPi, 4.0);
+
+	if (tt < 0.0)
+		tt += 4.0;
+
+	if (tt >= 4.0)
+		tt = 0.0;
+
+	if (za <= 2.0 / 3.0)
+	{
+		// Equatorial belt. jp and jm count the ascending and descending pixel edges crossed
+		double t1 = nside * (0.5 + tt);
+		double t2 = nside * (z * 0.75);
+
+		int64_t jp = static_cast<int64_t>(t1 - t2);
+		int64_t jm = static_cast<int64_t>(t1 + t2);
+
+		int64_t faceP = jp >> order;
+		int64_t faceM = jm >> order;
+		int64_t face = faceP == faceM ? (faceP | 4) : (faceP < faceM ? faceP : faceM + 8);
+
+		return toPixel(order, static_cast<uint32_t>(jm & mask), static_cast<uint32_t>(mask - (jp & mask)), static_cast<uint32_t>(face));
+	}
+
+	// Polar caps
+	int64_t quadrant = std::min<int64_t>(3, static_cast<int64_t>(tt));
+	double tp = tt - static_cast<double>(quadrant);
+	double t = nside * sinTheta * std::sqrt(3.0 / (1.0 + za));
+
+	int64_t jp = std::min(static_cast<int64_t>(tp * t), mask);
+	int64_t jm = std::min(static_cast<int64_t>((1.0 - tp) * t), mask);
+
+	if (z >= 0.0)
+		return toPixel(order, static_cast<uint32_t>(mask - jm), static_cast<uint32_t>(mask - jp), static_cast<uint32_t>(quadrant));
+
+	return toPixel(order, static_cast<uint32_t>(jp), static_cast<uint32_t>(jm), static_cast<uint32_t>(quadrant + 8));
+}
+
+static HealpixLocation pixelToLocation(unsigned int order, uint32_t pixel)
+{
+	const uint32_t nside = 1u << order;
+	const uint32_t local = pixel & ((1u << (2 * order)) - 1);
+
+	double x = (compactBits(local) + 0.5) / nside;
+	double y = (compactBits(local >> 1) + 0.5) / nside;
+
+	return faceToLocation(x, y, static_cast<int>(pixel >> (2 * order)));
+}
+
+// Pixel corners lie on 4 * nside + 1 rings of constant latitude. Ring r holds 4r corners in the
+// north cap, 4 * nside in the belt and one at each pole
+struct CornerRings
+{
+	int64_t nside;
+	int64_t total;
+
+	// Corners per quarter turn
+	int64_t width(int64_t ring) const
+	{
+		if (ring < nside)
+			return ring;
+
+		if (ring > 3 * nside)
+			return 4 * nside - ring;
+
+		return nside;
+	}
+
+	// Belt rings alternate between corners on and between the face longitudes
+	int64_t parity(int64_t ring) const
+	{
+		return ring > nside && ring < 3 * nside ? (nside + ring) & 1 : 0;
+	}
+
+	int64_t count(int64_t ring) const
+	{
+		int64_t w = width(ring);
+		return w == 0 ? 1 : 4 * w;
+	}
+
+	// Index of the first corner of `ring`
+	int64_t start(int64_t ring) const
+	{
+		if (ring == 0)
+			return 0;
+
+		if (ring <= nside)
+			return 1 + 2 * ring * (ring - 1);
+
+		if (ring <= 3 * nside)
+			return 1 + 2 * nside * (nside - 1) + 4 * nside * (ring - nside);
+
+		int64_t south = 4 * nside - ring;
+		return total - 1 - 2 * south * (south + 1);
+	}
+
+	// Index of corner (i, j) of base face `face`, with i, j in [0, nside]
+	unsigned int corner(int face, int64_t i, int64_t j) const
+	{
+		int64_t ring = faceRing[face] * nside - i - j;
+		int64_t w = width(ring);
+
+		if (w == 0)
+			return static_cast<unsigned int>(start(ring));
+
+		int64_t t = (facePhi[face] * w + i - j) % (8 * w);
+
+		if (t < 0)
+			t += 8 * w;
+
+		return static_cast<unsigned int>(start(ring) + (t - parity(ring)) / 2);
+	}
+};
+
+size_t getHealpixPixelCount(unsigned int order)
+{
+	return size_t {12} << (2 * order);
+}
+
+size_t getHealpixVertexCount(unsigned int order)
+{
+	return getHealpixPixelCount(order) + 2;
+}
+
+void generateHealpixGrid(ThreadPool& threadPool, unsigned int order, float* vertices, unsigned int* indices)
+{
+	const int64_t nside = int64_t {1} << order;
+	const CornerRings rings {nside, static_cast<int64_t>(getHealpixVertexCount(order))};
+
+	threadPool.parallelFor(static_cast<size_t>(4 * nside + 1), [&](size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; r++)
+		{
+			const int64_t ring = static_cast<int64_t>(r);
+			const int64_t width = rings.width(ring);
+			const int64_t south = 4 * nside - ring;
+
+			double z = 0.0;
+			double sinTheta = 0.0;
+
+			if (ring <= nside || ring >= 3 * nside)
+			{
+				double w = static_cast<double>(ring <= nside ? ring : south) / nside;
+				double t = w * w / 3.0;
+
+				z = ring <= nside ? 1.0 - t : t - 1.0;
+				sinTheta = std::sqrt(t * (2.0 - t));
+			}
+			else
+			{
+				z = static_cast<double>(2 * nside - ring) * 2.0 / (3.0 * nside);
+				sinTheta = std::sqrt((1.0 - z) * (1.0 + z));
+			}
+
+			const int64_t first = rings.start(ring);
+			const int64_t count = rings.count(ring);
+			const int64_t parity = rings.parity(ring);
+
+			for (int64_t k = 0; k < count; k++)
+			{
+				double phi = width == 0 ? 0.0 : quarterPi * static_cast<double>(2 * k + parity) / width;
+				float* vertex = vertices + (first + k) * 3;
+
+				vertex[0] = static_cast<float>(sinTheta * std::cos(phi));
+				vertex[1] = static_cast<float>(z);
+				vertex[2] = static_cast<float>(sinTheta * std::sin(phi));
+			}
+		}
+	});
+
+	const uint32_t facePixels = static_cast<uint32_t>(nside * nside);
+
+	threadPool.parallelFor(getHealpixPixelCount(order), [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end; p++)
+		{
+			const uint32_t pixel = static_cast<uint32_t>(p);
+			const int face = static_cast<int>(pixel / facePixels);
+			const uint32_t local = pixel % facePixels;
+
+			const int64_t ix = compactBits(local);
+			const int64_t iy = compactBits(local >> 1);
+
+			unsigned int south = rings.corner(face, ix, iy);
+			unsigned int east = rings.corner(face, ix + 1, iy);
+			unsigned int north = rings.corner(face, ix + 1, iy + 1);
+			unsigned int west = rings.corner(face, ix, iy + 1);
+
+			// Longitude runs from +x towards +z, which turns east clockwise seen from outside
+			unsigned int* triangles = indices + p * 6;
+
+			triangles[0] = south;
+			triangles[1] = north;
+			triangles[2] = east;
+			triangles[3] = south;
+			triangles[4] = west;
+			triangles[5] = north;
+		}
+	});
+}
+
+uint32_t healpixAng2Pix(unsigned int order, double theta, double phi)
+{
+	return locationToPixel(order, std::cos(theta), std::abs(std::sin(theta)), phi);
+}
+
+glm::dvec2 healpixPix2Ang(unsigned int order, uint32_t pixel)
+{
+	HealpixLocation location = pixelToLocation(order, pixel);
+	return {std::atan2(location.sinTheta, location.z), location.phi};
+}
+
+uint32_t healpixVec2Pix(unsigned int order, const glm::vec3& direction)
+{
+	const double x = direction.x;
+	const double y = direction.y;
+	const double z = direction.z;
+
+	const double length = std::sqrt(x * x + y * y + z * z);
+
+	// Matches the batch, which can't branch on it
+	if (length == 0.0)
+		return locationToPixel(order, 0.0, 0.0, 0.0);
+
+	return locationToPixel(order, y / length, std::sqrt(x * x + z * z) / length, std::atan2(z, x));
+}
+
+glm::vec3 healpixPix2Vec(unsigned int order, uint32_t pixel)
+{
+	HealpixLocation location = pixelToLocation(order, pixel);
+
+	return {
+		static_cast<float>(location.sinTheta * std::cos(location.phi)),
+		static_cast<float>(location.z),
+		static_cast<float>(location.sinTheta * std::sin(location.phi))};
+}
+
+#ifdef CPU_FEATURES_X86
+
+// a * b + c. FMA is a separate CPU feature from AVX2, so it isn't used
+TARGET_AVX2 static __m256 multiplyAddAVX2(__m256 a, __m256 b, __m256 c)
+{
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+
+TARGET_AVX2 static __m256i spreadBitsAVX2(__m256i v)
+{
+	v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x00FF00FF));
+	v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+	v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x33333333));
+	v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 1)), _mm256_set1_epi32(0x55555555));
+	return v;
+}
+
+// atan2(y, x) in quarter turns in [0, 4), with the Cephes atanf polynomial on [0, tan(pi / 8)]
+TARGET_AVX2 static __m256 quarterTurnsAVX2(__m256 y, __m256 x)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	__m256 ax = _mm256_andnot_ps(signMask, x);
+	__m256 ay = _mm256_andnot_ps(signMask, y);
+
+	__m256 high = _mm256_max_ps(ax, ay);
+	__m256 low = _mm256_min_ps(ax, ay);
+
+	// Both zero only at the poles, where any longitude will do
+	__m256 ratio = _mm256_div_ps(low, _mm256_max_ps(high, _mm256_set1_ps(1e-30f)));
+
+	// Above tan(pi / 8), atan(t) = pi / 4 + atan((t - 1) / (t + 1))
+	__m256 reduce = _mm256_cmp_ps(ratio, _mm256_set1_ps(0.41421356f), _CMP_GT_OQ);
+	__m256 t = _mm256_blendv_ps(ratio, _mm256_div_ps(_mm256_sub_ps(ratio, one), _mm256_add_ps(ratio, one)), reduce);
+	__m256 angle = _mm256_and_ps(reduce, _mm256_set1_ps(static_cast<float>(quarterPi)));
+
+	__m256 t2 = _mm256_mul_ps(t, t);
+	__m256 poly = multiplyAddAVX2(_mm256_set1_ps(8.05374449538e-2f), t2, _mm256_set1_ps(-1.38776856032e-1f));
+	poly = multiplyAddAVX2(poly, t2, _mm256_set1_ps(1.99777106478e-1f));
+	poly = multiplyAddAVX2(poly, t2, _mm256_set1_ps(-3.33329491539e-1f));
+	angle = _mm256_add_ps(angle, multiplyAddAVX2(_mm256_mul_ps(poly, t2), t, t));
+
+	// Back from the first octant, in quarter turns from here on
+	angle = _mm256_mul_ps(angle, _mm256_set1_ps(static_cast<float>(1.0 / halfPi)));
+	angle = _mm256_blendv_ps(angle, _mm256_sub_ps(one, angle), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+	angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(2.0f), angle), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+	angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(4.0f), angle), _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+
+	return _mm256_andnot_ps(_mm256_cmp_ps(angle, _mm256_set1_ps(4.0f), _CMP_GE_OQ), angle);
+}
+
+// locationToPixel for 8 directions at once, both regions computed and blended
+TARGET_AVX2 static size_t vec2PixAVX2(unsigned int order, const float* x, const float* y, const float* z, size_t count, uint32_t* pixels)
+{
+	const __m128i orderShift = _mm_cvtsi32_si128(static_cast<int>(order));
+	const __m128i faceShift = _mm_cvtsi32_si128(static_cast<int>(2 * order));
+
+	const __m256 nside = _mm256_set1_ps(static_cast<float>(1u << order));
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>((1u << order) - 1));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 vz = _mm256_loadu_ps(z + i);
+
+		__m256 radial2 = multiplyAddAVX2(vz, vz, _mm256_mul_ps(vx, vx));
+		__m256 length2 = multiplyAddAVX2(vy, vy, radial2);
+
+		// A zero vector lands on the equator instead of producing NaN indices
+		__m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(length2));
+		invLength = _mm256_andnot_ps(_mm256_cmp_ps(length2, _mm256_setzero_ps(), _CMP_EQ_OQ), invLength);
+
+		__m256 cosTheta = _mm256_mul_ps(vy, invLength);
+		__m256 sinTheta = _mm256_mul_ps(_mm256_sqrt_ps(radial2), invLength);
+		__m256 za = _mm256_andnot_ps(signMask, cosTheta);
+		__m256 tt = quarterTurnsAVX2(vz, vx);
+
+		// Equatorial belt
+		__m256 t1 = _mm256_mul_ps(nside, _mm256_add_ps(_mm256_set1_ps(0.5f), tt));
+		__m256 t2 = _mm256_mul_ps(nside, _mm256_mul_ps(cosTheta, _mm256_set1_ps(0.75f)));
+
+		__m256i jp = _mm256_cvttps_epi32(_mm256_sub_ps(t1, t2));
+		__m256i jm = _mm256_cvttps_epi32(_mm256_add_ps(t1, t2));
+
+		__m256i faceP = _mm256_srl_epi32(jp, orderShift);
+		__m256i faceM = _mm256_srl_epi32(jm, orderShift);
+
+		__m256i beltFace = _mm256_blendv_epi8(
+			_mm256_add_epi32(faceM, _mm256_set1_epi32(8)), faceP, _mm256_cmpgt_epi32(faceM, faceP));
+		beltFace = _mm256_blendv_epi8(
+			beltFace, _mm256_or_si256(faceP, _mm256_set1_epi32(4)), _mm256_cmpeq_epi32(faceP, faceM));
+
+		__m256i beltX = _mm256_and_si256(jm, mask);
+		__m256i beltY = _mm256_sub_epi32(mask, _mm256_and_si256(jp, mask));
+
+		// Polar caps
+		__m256i quadrant = _mm256_min_epi32(_mm256_cvttps_epi32(tt), _mm256_set1_epi32(3));
+		__m256 tp = _mm256_sub_ps(tt, _mm256_cvtepi32_ps(quadrant));
+		__m256 scale = _mm256_mul_ps(_mm256_mul_ps(nside, sinTheta),
+			_mm256_sqrt_ps(_mm256_div_ps(_mm256_set1_ps(3.0f), _mm256_add_ps(one, za))));
+
+		__m256i capP = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(tp, scale)), mask);
+		__m256i capM = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(one, tp), scale)), mask);
+
+		__m256i south = _mm256_castps_si256(_mm256_cmp_ps(cosTheta, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+		__m256i capX = _mm256_blendv_epi8(_mm256_sub_epi32(mask, capM), capP, south);
+		__m256i capY = _mm256_blendv_epi8(_mm256_sub_epi32(mask, capP), capM, south);
+		__m256i capFace = _mm256_add_epi32(quadrant, _mm256_and_si256(south, _mm256_set1_epi32(8)));
+
+		__m256i belt = _mm256_castps_si256(_mm256_cmp_ps(za, _mm256_set1_ps(2.0f / 3.0f), _CMP_LE_OQ));
+
+		__m256i ix = _mm256_blendv_epi8(capX, beltX, belt);
+		__m256i iy = _mm256_blendv_epi8(capY, beltY, belt);
+		__m256i face = _mm256_blendv_epi8(capFace, beltFace, belt);
+
+		__m256i pixel = _mm256_or_si256(_mm256_sll_epi32(face, faceShift),
+			_mm256_or_si256(spreadBitsAVX2(ix), _mm256_slli_epi32(spreadBitsAVX2(iy), 1)));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), pixel);
+	}
+
+	return i;
+}
+
+#endif
+
+void healpixVec2PixBatch(unsigned int order, const float* x, const float* y, const float* z, size_t count, uint32_t* pixels)
+{
+	size_t done = 0;
+
+#ifdef CPU_FEATURES_X86
+	if (cpuSupportsAVX2())
+		done = vec2PixAVX2(order, x, y, z, count, pixels);
+#endif
+
+	for (size_t i = done; i < count; i++)
+		pixels[i] = healpixVec2Pix(order, {x[i], y[i], z[i]});
+}
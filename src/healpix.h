@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "thread_pool.h"
+
+// HEALPix (Gorski et al., 2005): 12 * nside^2 equal-area pixels, 12 base faces each split into an
+// nside by nside grid. Pixels use the nested scheme, so pixel p at order k holds pixels 4p to 4p + 3
+// at order k + 1. nside is 2^order. The y axis is the polar axis and phi = atan2(z, x), as for the
+// Fibonacci sphere
+
+// Deepest order whose pixel indices still fit in 32 bits
+constexpr unsigned int healpixMaxOrder = 13;
+
+size_t getHealpixPixelCount(unsigned int order);
+// Pixel corners, shared between neighbouring pixels
+size_t getHealpixVertexCount(unsigned int order);
+
+// Writes the corner grid to `vertices` as xyz triples and two triangles per pixel to `indices`,
+// in nested pixel order. Pixel p owns triangles 2p and 2p + 1
+void generateHealpixGrid(ThreadPool& threadPool, unsigned int order, float* vertices, unsigned int* indices);
+
+// Pixel containing the direction with colatitude `theta` from +y and longitude `phi`
+uint32_t healpixAng2Pix(unsigned int order, double theta, double phi);
+// Colatitude and longitude of the center of `pixel`
+glm::dvec2 healpixPix2Ang(unsigned int order, uint32_t pixel);
+
+// Pixel containing `direction`, which doesn't need to be normalized
+uint32_t healpixVec2Pix(unsigned int order, const glm::vec3& direction);
+glm::vec3 healpixPix2Vec(unsigned int order, uint32_t pixel);
+
+// Bins `count` directions given as structure-of-arrays. Uses AVX2 where the CPU supports it, which
+// works in single precision and can disagree with healpixVec2Pix within a few ulps of a pixel edge
+void healpixVec2PixBatch(unsigned int order, const float* x, const float* y, const float* z, size_t count, uint32_t* pixels);
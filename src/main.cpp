@@ -1,7 +1,7 @@
 #include "application.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-    Application application;
+    Application application(argc > 1 ? argv[1] : "");
     application.run();
 }
\ No newline at end of file
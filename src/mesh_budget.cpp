@@ -0,0 +1,303 @@
+#include "mesh_budget.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <numbers>
+
+// Positions are stored as floats, whose rounding over a few operations moves them up to this far
+// from the sphere
+static constexpr double floatError = 4e-7;
+
+// Angular circumradius of the largest triangle times 2^level, which creeps up with the level as
+// midpoint passes make the triangles less even. Limits measured on the built meshes, rounded up
+static constexpr double icosphereSpread = 0.765;
+static constexpr double healpixSpread = 1.075;
+
+// The same creep for midpoint passes over a cube grid, relative to the grid itself
+static constexpr double subdivisionGrowth = 1.2;
+
+// Midpoint passes simulated on sector sphere triangles. The creep over any further passes is
+// under this factor
+static constexpr unsigned int simulatedPasses = 4;
+static constexpr double remainingGrowth = 1.01;
+
+// Candidates stop here, beyond it vertex indices no longer fit in 32 bits
+static constexpr size_t maxCandidateTriangles = size_t {1} << 30;
+
+static double sagitta(double angle)
+{
+	return 1.0 - std::cos(angle);
+}
+
+// A grid cell spanning [-h, h]^2 on the plane touching the sphere projects to four coplanar
+// points at distance 1 / sqrt(1 + 2h^2) from the center
+static double gridCellError(double halfWidth)
+{
+	return 1.0 - 1.0 / std::sqrt(1.0 + 2.0 * halfWidth * halfWidth);
+}
+
+// The cells at the face centers are the largest, equal spacing or equal angles
+static double cubeGridError(unsigned int resolution, bool warp)
+{
+	double halfWidth = warp ? std::tan(std::numbers::pi / (4.0 * resolution)) : 1.0 / resolution;
+	return gridCellError(halfWidth);
+}
+
+// Largest error among the triangles `passes` midpoint subdivisions make of triangle abc
+static double subdividedError(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, unsigned int passes)
+{
+	if (passes == 0)
+		return getTriangleSphereError(a, b, c);
+
+	auto midpoint = [](const glm::dvec3& p, const glm::dvec3& q)
+	{
+		glm::dvec3 sum = p + q;
+		return sum * (1.0 / glm::length(sum));
+	};
+
+	glm::dvec3 ab = midpoint(a, b);
+	glm::dvec3 bc = midpoint(b, c);
+	glm::dvec3 ca = midpoint(c, a);
+
+	return std::max(
+		std::max(subdividedError(a, ab, ca, passes - 1), subdividedError(ab, b, bc, passes - 1)),
+		std::max(subdividedError(ca, bc, c, passes - 1), subdividedError(ab, bc, ca, passes - 1)));
+}
+
+// Every quad of a band is the same up to rotation. The bands touching the equator are the widest
+// and the polar bands the least even, so their first quads bound the whole mesh
+static double sectorError(unsigned int sectors, unsigned int stacks, unsigned int level)
+{
+	auto point = [sectors, stacks](unsigned int i, unsigned int j) -> glm::dvec3
+	{
+		double phi = 0.5 * std::numbers::pi - std::numbers::pi * i / stacks;
+		double theta = 2.0 * std::numbers::pi * j / sectors;
+
+		return {std::cos(phi) * std::cos(theta), std::sin(phi), std::cos(phi) * std::sin(theta)};
+	};
+
+	const unsigned int passes = std::min(level, simulatedPasses);
+	double error = 0.0;
+
+	for (unsigned int i : {0u, (stacks - 1) / 2, stacks / 2})
+	{
+		if (i != 0)
+			error = std::max(error, subdividedError(point(i, 0), point(i, 1), point(i + 1, 0), passes));
+
+		if (i != stacks - 1)
+			error = std::max(error, subdividedError(point(i + 1, 0), point(i, 1), point(i + 1, 1), passes));
+	}
+
+	if (level == passes)
+		return error;
+
+	return sagitta(remainingGrowth * std::acos(1.0 - error) * std::ldexp(1.0, -static_cast<int>(level - passes)));
+}
+
+// Counts after `level` subdivision passes over a mesh with `boundaryEdges` open edges.
+// Shared passes add one vertex per edge, duplicated ones give every triangle its own six
+static void subdivideCounts(MeshEstimate& estimate, size_t boundaryEdges, unsigned int level, SubdivisionMode mode)
+{
+	size_t edges = (estimate.triangleCount * 3 + boundaryEdges) / 2;
+
+	for (unsigned int i = 0; i < level; i++)
+	{
+		if (mode == SubdivisionMode::Duplicated)
+			estimate.vertexCount = estimate.triangleCount * 6;
+		else
+			estimate.vertexCount += edges;
+
+		edges = edges * 2 + estimate.triangleCount * 3;
+		estimate.triangleCount *= 4;
+	}
+}
+
+bool estimateMesh(const MeshKey& key, MeshEstimate& estimate)
+{
+	estimate = {};
+	estimate.key = key;
+
+	const double levelScale = std::ldexp(1.0, -static_cast<int>(key.level));
+
+	if (key.type == SphereType::IcoSphere)
+	{
+		estimate.vertexCount = 12;
+		estimate.triangleCount = 20;
+		subdivideCounts(estimate, 0, key.level, key.mode);
+
+		estimate.error = sagitta(icosphereSpread * levelScale);
+	}
+	else if (key.type == SphereType::CubeSphere || key.type == SphereType::SectorSphere)
+	{
+		size_t boundaryEdges = 0;
+
+		if (key.type == SphereType::CubeSphere)
+		{
+			size_t n = std::max(key.resolution, 1u);
+
+			estimate.vertexCount = 6 * n * n + 2;
+			estimate.triangleCount = 12 * n * n;
+
+			double gridError = cubeGridError(static_cast<unsigned int>(n), key.warp);
+			estimate.error = key.level == 0 ? gridError : sagitta(subdivisionGrowth * std::acos(1.0 - gridError) * levelScale);
+		}
+		else
+		{
+			size_t sectors = std::max(key.sectors, 1u);
+			size_t stacks = std::max(key.stacks, 1u);
+
+			// The seam and the poles repeat their vertices, so the polar triangles only touch each other
+			// at a vertex and the seam columns are only joined by position, which leaves those edges open
+			estimate.vertexCount = (sectors + 1) * (stacks + 1);
+			estimate.triangleCount = stacks > 1 ? sectors * 2 * (stacks - 1) : 0;
+			boundaryEdges = stacks > 1 ? 4 * sectors + 2 * (stacks - 2) : 0;
+
+			if (estimate.triangleCount != 0)
+				estimate.error = sectorError(static_cast<unsigned int>(sectors), static_cast<unsigned int>(stacks), key.level);
+		}
+
+		subdivideCounts(estimate, boundaryEdges, key.level, key.mode);
+	}
+	else if (key.type == SphereType::OctaSphere)
+	{
+		unsigned int segments = std::max(key.resolution, 1u) << key.level;
+
+		estimate.vertexCount = getOctaSphereVertexCount(segments);
+		estimate.triangleCount = getOctaSphereTriangleCount(segments);
+		estimate.error = gridCellError(1.0 / segments);
+	}
+	else if (key.type == SphereType::HEALPix)
+	{
+		unsigned int order = std::min(key.level, healpixMaxOrder);
+
+		estimate.vertexCount = getHealpixVertexCount(order);
+		estimate.triangleCount = getHealpixPixelCount(order) * 2;
+		estimate.error = sagitta(healpixSpread * std::ldexp(1.0, -static_cast<int>(order)));
+	}
+	else
+	{
+		return false;
+	}
+
+	estimate.error += floatError;
+	return true;
+}
+
+// Visits the estimates of makeKey(first), makeKey(first + 1) ... up to makeKey(last), stopping
+// early at the first one above `maxTriangles` or when `visit` returns false
+static void visitSeries(unsigned int first, unsigned int last, size_t maxTriangles,
+	const std::function<MeshKey(unsigned int)>& makeKey,
+	const std::function<bool(const MeshEstimate&)>& visit)
+{
+	for (unsigned int i = first; i <= last; i++)
+	{
+		MeshEstimate estimate {};
+		estimateMesh(makeKey(i), estimate);
+
+		if (estimate.triangleCount > maxTriangles || !visit(estimate))
+			return;
+	}
+}
+
+// Every type and parameter set with a fixed mesh, each series in order of growing triangle count.
+// Level-based types step by 4x, the grids take any resolution to land close to any count
+static void visitCandidates(SubdivisionMode mode, size_t maxTriangles, const std::function<bool(const MeshEstimate&)>& visit)
+{
+	auto makeKey = [mode](SphereType type)
+	{
+		MeshKey key {};
+		key.type = type;
+		key.mode = mode;
+		return key;
+	};
+
+	visitSeries(0, UINT_MAX, maxTriangles, [&](unsigned int level)
+	{
+		MeshKey key = makeKey(SphereType::IcoSphere);
+		key.level = level;
+		return key;
+	}, visit);
+
+	visitSeries(0, healpixMaxOrder, maxTriangles, [&](unsigned int order)
+	{
+		MeshKey key = makeKey(SphereType::HEALPix);
+		key.level = order;
+		return key;
+	}, visit);
+
+	visitSeries(1, UINT_MAX, maxTriangles, [&](unsigned int segments)
+	{
+		MeshKey key = makeKey(SphereType::OctaSphere);
+		key.resolution = segments;
+		return key;
+	}, visit);
+
+	for (bool warp : {false, true})
+	{
+		visitSeries(1, UINT_MAX, maxTriangles, [&](unsigned int resolution)
+		{
+			MeshKey key = makeKey(SphereType::CubeSphere);
+			key.resolution = resolution;
+			key.warp = warp;
+			return key;
+		}, visit);
+	}
+
+	// Square cells in angle are the most accurate for a given count
+	visitSeries(2, UINT_MAX / 2, maxTriangles, [&](unsigned int stacks)
+	{
+		MeshKey key = makeKey(SphereType::SectorSphere);
+		key.sectors = stacks * 2;
+		key.stacks = stacks;
+		return key;
+	}, visit);
+}
+
+bool chooseMeshForBudget(size_t maxTriangles, SubdivisionMode mode, MeshEstimate& choice)
+{
+	bool found = false;
+
+	visitCandidates(mode, std::min(maxTriangles, maxCandidateTriangles), [&](const MeshEstimate& estimate)
+	{
+		bool better = estimate.error < choice.error ||
+			(estimate.error == choice.error && estimate.vertexCount < choice.vertexCount);
+
+		if (!found || better)
+		{
+			choice = estimate;
+			found = true;
+		}
+
+		return true;
+	});
+
+	return found;
+}
+
+bool chooseMeshForError(double maxError, SubdivisionMode mode, MeshEstimate& choice)
+{
+	bool found = false;
+
+	visitCandidates(mode, maxCandidateTriangles, [&](const MeshEstimate& estimate)
+	{
+		// The rest of the series only gets bigger
+		if (found && estimate.triangleCount > choice.triangleCount)
+			return false;
+
+		if (estimate.error > maxError)
+			return true;
+
+		if (!found || estimate.triangleCount < choice.triangleCount || estimate.error < choice.error)
+		{
+			choice = estimate;
+			found = true;
+		}
+
+		return false;
+	});
+
+	return found;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include "mesh_cache.h"
+
+// Size and accuracy of a mesh, predicted from its key without building it
+struct MeshEstimate
+{
+	MeshKey key {};
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	// Upper bound on the distance between the mesh and the unit sphere
+	double error = 0.0;
+};
+
+// Closed-form counts and error for `key`. Returns false for adaptive and point spheres,
+// which have no mesh fixed by their key
+bool estimateMesh(const MeshKey& key, MeshEstimate& estimate);
+
+// Most accurate mesh of any type with at most `maxTriangles` triangles. Types built by
+// subdivision passes are estimated in `mode`. Returns false if nothing fits
+bool chooseMeshForBudget(size_t maxTriangles, SubdivisionMode mode, MeshEstimate& choice);
+
+// Mesh of any type with the fewest triangles whose error stays at or below `maxError`,
+// relative to the radius. Returns false if no mesh gets that close
+bool chooseMeshForError(double maxError, SubdivisionMode mode, MeshEstimate& choice);
@@ -0,0 +1,188 @@
+#include "mesh_cache.h"
+#include "sphere.h"
+
+bool MeshKey::sameShape(const MeshKey& other) const
+{
+	return type == other.type &&
+		mode == other.mode &&
+		sectors == other.sectors &&
+		stacks == other.stacks &&
+		resolution == other.resolution &&
+		warp == other.warp;
+}
+
+void MeshCache::setBudget(size_t bytes)
+{
+	budget = bytes;
+	enforceBudget();
+}
+
+size_t MeshCache::getBudget() const
+{
+	return budget;
+}
+
+size_t MeshCache::getUsedBytes() const
+{
+	return usedBytes;
+}
+
+size_t MeshCache::getEntryCount() const
+{
+	return entries.size();
+}
+
+void MeshCache::store(const MeshKey& key,
+	std::span<const float> vertices,
+	std::span<const unsigned int> indices,
+	MeshBuffers buffers,
+	size_t gpuBytes)
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].key == key)
+		{
+			evict(i);
+			break;
+		}
+	}
+
+	Entry& entry = entries.emplace_back();
+	entry.key = key;
+	entry.vertices.assign(vertices.begin(), vertices.end());
+	entry.indices.assign(indices.begin(), indices.end());
+	entry.buffers = buffers;
+	entry.uploaded = gpuBytes > 0;
+	entry.gpuBytes = gpuBytes;
+	entry.lastUse = ++useCounter;
+
+	// Count the CPU copy, and the GPU copy once it has been uploaded
+	entry.bytes = entry.vertices.size() * sizeof(float) + entry.indices.size() * sizeof(unsigned int) + gpuBytes;
+
+	usedBytes += entry.bytes;
+	enforceBudget();
+}
+
+bool MeshCache::contains(const MeshKey& key) const
+{
+	for (const Entry& entry : entries)
+	{
+		if (entry.key == key)
+			return true;
+	}
+
+	return false;
+}
+
+bool MeshCache::take(const MeshKey& key,
+	ArenaVector<float>& vertices,
+	ArenaVector<unsigned int>& indices,
+	MeshBuffers& buffers,
+	bool& uploaded)
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries[i];
+
+		if (entry.key != key)
+			continue;
+
+		vertices.assign(entry.vertices.begin(), entry.vertices.end());
+		indices.assign(entry.indices.begin(), entry.indices.end());
+		buffers = entry.buffers;
+		uploaded = entry.uploaded;
+
+		usedBytes -= entry.bytes;
+
+		// Order doesn't matter, so move the last entry into the gap instead of shifting
+		if (i + 1 != entries.size())
+			entries[i] = std::move(entries.back());
+
+		entries.pop_back();
+
+		return true;
+	}
+
+	return false;
+}
+
+bool MeshCache::copyBelow(const MeshKey& key,
+	ArenaVector<float>& vertices,
+	ArenaVector<unsigned int>& indices,
+	unsigned int& level)
+{
+	Entry* best = nullptr;
+
+	for (Entry& entry : entries)
+	{
+		if (entry.key.sameShape(key) && entry.key.level < key.level &&
+			(best == nullptr || entry.key.level > best->key.level))
+		{
+			best = &entry;
+		}
+	}
+
+	if (best == nullptr)
+		return false;
+
+	vertices.assign(best->vertices.begin(), best->vertices.end());
+	indices.assign(best->indices.begin(), best->indices.end());
+	level = best->key.level;
+	best->lastUse = ++useCounter;
+
+	return true;
+}
+
+void MeshCache::clear()
+{
+	while (!entries.empty())
+		evict(entries.size() - 1);
+}
+
+void MeshCache::discardUploads()
+{
+	for (Entry& entry : entries)
+	{
+		usedBytes -= entry.gpuBytes;
+		entry.bytes -= entry.gpuBytes;
+
+		entry.gpuBytes = 0;
+		entry.uploaded = false;
+	}
+}
+
+std::vector<MeshBuffers>& MeshCache::getFreeBuffers()
+{
+	return freeBuffers;
+}
+
+void MeshCache::evict(size_t index)
+{
+	Entry& entry = entries[index];
+
+	if (entry.buffers.VAO != 0)
+		freeBuffers.push_back(entry.buffers);
+
+	usedBytes -= entry.bytes;
+
+	if (index + 1 != entries.size())
+		entries[index] = std::move(entries.back());
+
+	entries.pop_back();
+}
+
+void MeshCache::enforceBudget()
+{
+	while (usedBytes > budget && !entries.empty())
+	{
+		size_t oldest = 0;
+
+		for (size_t i = 1; i < entries.size(); i++)
+		{
+			if (entries[i].lastUse < entries[oldest].lastUse)
+				oldest = i;
+		}
+
+		evict(oldest);
+	}
+}
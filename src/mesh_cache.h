@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "arena.h"
+
+enum class SphereType;
+enum class SubdivisionMode;
+
+// Identifies one generated mesh: the shape, its parameters and the subdivision level
+struct MeshKey
+{
+	SphereType type {};
+	SubdivisionMode mode {};
+	unsigned int sectors = 0;
+	unsigned int stacks = 0;
+	unsigned int resolution = 0;
+	bool warp = false;
+	unsigned int level = 0;
+
+	bool operator==(const MeshKey& other) const = default;
+
+	// True if both keys describe the same shape, regardless of level
+	bool sameShape(const MeshKey& other) const;
+};
+
+// Meshes with fewer vertices than this are drawn with 16-bit indices
+constexpr size_t shortIndexVertexLimit = 65536;
+
+// Bytes per index in the GPU copy of a mesh with `vertexCount` vertices
+constexpr size_t getIndexWidth(size_t vertexCount)
+{
+	return vertexCount < shortIndexVertexLimit ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// OpenGL objects holding the GPU copy of a mesh
+struct MeshBuffers
+{
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	unsigned int EBO = 0;
+	// Bytes of storage behind VBO and EBO, which later uploads reuse when they fit
+	size_t vertexCapacity = 0;
+	size_t indexCapacity = 0;
+};
+
+// Keeps previously generated meshes and their GPU buffers, so that going back to
+// a level is a copy instead of a regeneration. Bounded by a memory budget with
+// least recently used eviction. Never calls OpenGL itself, evicted buffers are handed
+// back to the owner through getFreeBuffers()
+class MeshCache
+{
+public:
+	MeshCache() = default;
+
+	// A budget of 0 disables the cache
+	void setBudget(size_t bytes);
+	size_t getBudget() const;
+
+	size_t getUsedBytes() const;
+	size_t getEntryCount() const;
+
+	// Copies the mesh into the cache, replacing any entry with the same key. The owner's storage
+	// is reset with every new shape, so entries keep their own copy.
+	// `gpuBytes` is the size of the uploaded buffers, 0 if they hold no current data
+	void store(const MeshKey& key,
+		std::span<const float> vertices,
+		std::span<const unsigned int> indices,
+		MeshBuffers buffers,
+		size_t gpuBytes);
+
+	bool contains(const MeshKey& key) const;
+
+	// Copies a cached mesh out and removes it from the cache. Returns false if the key is not cached
+	bool take(const MeshKey& key,
+		ArenaVector<float>& vertices,
+		ArenaVector<unsigned int>& indices,
+		MeshBuffers& buffers,
+		bool& uploaded);
+
+	// Copies the highest cached level below `key.level` of the same shape.
+	// Returns false if there is none
+	bool copyBelow(const MeshKey& key,
+		ArenaVector<float>& vertices,
+		ArenaVector<unsigned int>& indices,
+		unsigned int& level);
+
+	void clear();
+
+	// Marks every cached GPU copy as stale, for when the buffer layout changes.
+	// The buffers are kept and filled again once their mesh is restored
+	void discardUploads();
+
+	// Buffers of evicted meshes, to be reused or deleted by the owner
+	std::vector<MeshBuffers>& getFreeBuffers();
+
+private:
+	struct Entry
+	{
+		MeshKey key {};
+		std::vector<float> vertices {};
+		std::vector<unsigned int> indices {};
+		MeshBuffers buffers {};
+		bool uploaded = false;
+		size_t bytes = 0;
+		size_t gpuBytes = 0;
+		uint64_t lastUse = 0;
+	};
+
+	void evict(size_t index);
+	void enforceBudget();
+
+	std::vector<Entry> entries {};
+	std::vector<MeshBuffers> freeBuffers {};
+
+	size_t budget = 0;
+	size_t usedBytes = 0;
+	uint64_t useCounter = 0;
+};
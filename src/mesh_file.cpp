@@ -0,0 +1,407 @@
+#include "mesh_file.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char meshFileMagic[4] {'S', 'P', 'H', 'M'};
+
+// Indices are hashed and range checked in blocks of this many bytes, so the check reads them
+// while they are still in cache. A multiple of 32 keeps the hash the same as in one piece
+static constexpr uint64_t indexBlockBytes = 64 * 1024;
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + meshFileAlignment - 1) / meshFileAlignment * meshFileAlignment;
+}
+
+// Adaptive and point spheres are never written, so a file claiming one is corrupt
+static bool isSavableType(uint32_t type)
+{
+	return type <= static_cast<uint32_t>(SphereType::SectorSphere) ||
+		type == static_cast<uint32_t>(SphereType::HEALPix) ||
+		type == static_cast<uint32_t>(SphereType::OctaSphere);
+}
+
+// Largest of `count` indices that are `width` bytes each
+static uint32_t findMaxIndex(const std::byte* indices, size_t count, size_t width)
+{
+	uint32_t maxIndex = 0;
+
+	if (width == sizeof(uint16_t))
+	{
+		const uint16_t* values = reinterpret_cast<const uint16_t*>(indices);
+
+		for (size_t i = 0; i < count; i++)
+			maxIndex = std::max<uint32_t>(maxIndex, values[i]);
+	}
+	else
+	{
+		const uint32_t* values = reinterpret_cast<const uint32_t*>(indices);
+
+		for (size_t i = 0; i < count; i++)
+			maxIndex = std::max(maxIndex, values[i]);
+	}
+
+	return maxIndex;
+}
+
+// Multiply-xor hash over 8 byte words in four independent lanes, so that
+// verifying a large mesh runs at memory speed instead of one byte per step
+class MeshHash
+{
+public:
+	void add(const void* bytes, size_t count)
+	{
+		const unsigned char* input = static_cast<const unsigned char*>(bytes);
+
+		size_t i = 0;
+
+		for (; i + 32 <= count; i += 32)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				uint64_t word = 0;
+				std::memcpy(&word, input + i + lane * 8, 8);
+				mix(lanes[lane], word);
+			}
+		}
+
+		for (; i + 8 <= count; i += 8)
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, input + i, 8);
+			mix(lanes[0], word);
+		}
+
+		if (i < count)
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, input + i, count - i);
+			mix(lanes[1], word);
+		}
+
+		length += count;
+	}
+
+	uint64_t finish() const
+	{
+		uint64_t hash = length;
+
+		for (uint64_t lane : lanes)
+			mix(hash, lane);
+
+		return hash;
+	}
+
+private:
+	static constexpr uint64_t prime = 0x9E3779B97F4A7C15ull;
+
+	static void mix(uint64_t& state, uint64_t word)
+	{
+		state = (state ^ word) * prime;
+		state ^= state >> 29;
+	}
+
+	uint64_t lanes[4] {1, 2, 3, 4};
+	uint64_t length = 0;
+};
+
+bool writeMeshFile(const std::string& path, const MeshKey& key,
+	const float* vertices, size_t vertexCount,
+	const void* indices, size_t indexCount, size_t indexWidth)
+{
+	MeshFileHeader header {};
+	std::memcpy(header.magic, meshFileMagic, sizeof(meshFileMagic));
+	header.version = meshFileVersion;
+
+	header.type = static_cast<uint32_t>(key.type);
+	header.mode = static_cast<uint32_t>(key.mode);
+	header.level = key.level;
+	header.sectors = key.sectors;
+	header.stacks = key.stacks;
+	header.resolution = key.resolution;
+	header.warp = key.warp;
+
+	header.indexWidth = static_cast<uint32_t>(indexWidth);
+
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+
+	const uint64_t vertexBytes = vertexCount * 3 * sizeof(float);
+	const uint64_t indexBytes = indexCount * indexWidth;
+
+	header.vertexOffset = alignOffset(sizeof(MeshFileHeader));
+	header.indexOffset = alignOffset(header.vertexOffset + vertexBytes);
+
+	MeshHash hash;
+	hash.add(vertices, vertexBytes);
+	hash.add(indices, indexBytes);
+	header.checksum = hash.finish();
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+	if (!output.is_open())
+	{
+		std::cout << "Could not open mesh file \"" << path << "\" for writing\n";
+		return false;
+	}
+
+	const char padding[meshFileAlignment] {};
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(padding, static_cast<std::streamsize>(header.vertexOffset - sizeof(header)));
+	output.write(reinterpret_cast<const char*>(vertices), static_cast<std::streamsize>(vertexBytes));
+	output.write(padding, static_cast<std::streamsize>(header.indexOffset - header.vertexOffset - vertexBytes));
+	output.write(reinterpret_cast<const char*>(indices), static_cast<std::streamsize>(indexBytes));
+
+	if (!output)
+	{
+		std::cout << "Could not write mesh file \"" << path << "\"\n";
+		return false;
+	}
+
+	return true;
+}
+
+MeshFile::~MeshFile()
+{
+	close();
+}
+
+MeshFile::MeshFile(MeshFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MeshFile& MeshFile::operator=(MeshFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+#ifdef _WIN32
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+		header = std::exchange(other.header, {});
+	}
+
+	return *this;
+}
+
+bool MeshFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Could not open mesh file \"" << path << "\"\n";
+		return false;
+	}
+
+	LARGE_INTEGER fileSize {};
+	GetFileSizeEx(file, &fileSize);
+
+	HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	fileHandle = file;
+	mappingHandle = mapping;
+
+	if (view == nullptr)
+	{
+		std::cout << "Could not map mesh file \"" << path << "\"\n";
+		close();
+		return false;
+	}
+
+	data = static_cast<const std::byte*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+
+	if (file < 0)
+	{
+		std::cout << "Could not open mesh file \"" << path << "\"\n";
+		return false;
+	}
+
+	struct stat status {};
+	fstat(file, &status);
+
+	void* view = status.st_size > 0 ? mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+
+	// The mapping keeps its own reference to the file
+	::close(file);
+
+	if (view == MAP_FAILED)
+	{
+		std::cout << "Could not map mesh file \"" << path << "\"\n";
+		return false;
+	}
+
+	// The whole file is read front to back by the checksum and the upload
+	madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL | MADV_WILLNEED);
+
+	data = static_cast<const std::byte*>(view);
+	size = static_cast<size_t>(status.st_size);
+#endif
+
+	if (size < sizeof(MeshFileHeader))
+	{
+		std::cout << "Mesh file \"" << path << "\" is truncated\n";
+		close();
+		return false;
+	}
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.magic, meshFileMagic, sizeof(meshFileMagic)) != 0 || header.version != meshFileVersion)
+	{
+		std::cout << "Mesh file \"" << path << "\" has an unknown format or version\n";
+		close();
+		return false;
+	}
+
+	const uint64_t vertexBytes = header.vertexCount * 3 * sizeof(float);
+	const uint64_t indexBytes = header.indexCount * header.indexWidth;
+
+	// The mesh is used at the width the vertex count calls for, so the file has to match it
+	bool valid = header.indexWidth == ::getIndexWidth(header.vertexCount) &&
+		header.vertexCount <= size / (3 * sizeof(float)) &&
+		header.indexCount <= size / header.indexWidth &&
+		isSavableType(header.type) &&
+		header.mode <= static_cast<uint32_t>(SubdivisionMode::Direct) &&
+		header.vertexOffset % meshFileAlignment == 0 &&
+		header.indexOffset % meshFileAlignment == 0 &&
+		header.vertexOffset >= sizeof(MeshFileHeader) &&
+		header.vertexOffset <= size && vertexBytes <= size - header.vertexOffset &&
+		header.indexOffset <= size && indexBytes <= size - header.indexOffset;
+
+	if (!valid)
+	{
+		std::cout << "Mesh file \"" << path << "\" has an invalid header\n";
+		close();
+		return false;
+	}
+
+	MeshHash hash;
+	hash.add(data + header.vertexOffset, vertexBytes);
+
+	const std::byte* indices = data + header.indexOffset;
+	uint32_t maxIndex = 0;
+
+	for (uint64_t offset = 0; offset < indexBytes; offset += indexBlockBytes)
+	{
+		const size_t blockBytes = static_cast<size_t>(std::min(indexBlockBytes, indexBytes - offset));
+
+		hash.add(indices + offset, blockBytes);
+		maxIndex = std::max(maxIndex, findMaxIndex(indices + offset, blockBytes / header.indexWidth, header.indexWidth));
+	}
+
+	if (hash.finish() != header.checksum)
+	{
+		std::cout << "Mesh file \"" << path << "\" failed its checksum\n";
+		close();
+		return false;
+	}
+
+	// The checksum only catches corruption, a file written with bad indices would still pass it
+	if (header.indexCount > 0 && maxIndex >= header.vertexCount)
+	{
+		std::cout << "Mesh file \"" << path << "\" has indices past its vertices\n";
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshFile::close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (data != nullptr)
+		munmap(const_cast<std::byte*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	header = {};
+}
+
+bool MeshFile::isOpen() const
+{
+	return data != nullptr;
+}
+
+MeshKey MeshFile::getKey() const
+{
+	MeshKey key {};
+	key.type = static_cast<SphereType>(header.type);
+	key.mode = static_cast<SubdivisionMode>(header.mode);
+	key.level = header.level;
+	key.sectors = header.sectors;
+	key.stacks = header.stacks;
+	key.resolution = header.resolution;
+	key.warp = header.warp != 0;
+
+	return key;
+}
+
+const float* MeshFile::getVertices() const
+{
+	return reinterpret_cast<const float*>(data + header.vertexOffset);
+}
+
+size_t MeshFile::getVertexCount() const
+{
+	return static_cast<size_t>(header.vertexCount);
+}
+
+const void* MeshFile::getIndices() const
+{
+	return data + header.indexOffset;
+}
+
+size_t MeshFile::getIndexCount() const
+{
+	return static_cast<size_t>(header.indexCount);
+}
+
+size_t MeshFile::getIndexWidth() const
+{
+	return header.indexWidth;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "mesh_cache.h"
+
+// Layout of a .sphmesh file: this header followed by the vertex blob (xyz floats)
+// and the index blob, each starting at a multiple of meshFileAlignment
+struct MeshFileHeader
+{
+	char magic[4] {};
+	uint32_t version = 0;
+
+	uint32_t type = 0;
+	uint32_t mode = 0;
+	uint32_t level = 0;
+	uint32_t sectors = 0;
+	uint32_t stacks = 0;
+	uint32_t resolution = 0;
+	uint32_t warp = 0;
+
+	// Bytes per index
+	uint32_t indexWidth = 0;
+
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	uint64_t vertexOffset = 0;
+	uint64_t indexOffset = 0;
+
+	// Hash of the vertex blob followed by the index blob
+	uint64_t checksum = 0;
+};
+
+constexpr uint32_t meshFileVersion = 1;
+constexpr size_t meshFileAlignment = 64;
+
+// Writes a mesh to `path`, returns false and prints the reason on failure.
+// `indices` holds `indexCount` indices of `indexWidth` bytes each (2 or 4)
+bool writeMeshFile(const std::string& path, const MeshKey& key,
+	const float* vertices, size_t vertexCount,
+	const void* indices, size_t indexCount, size_t indexWidth);
+
+// A read-only memory mapping of a .sphmesh file. The vertex and index pointers
+// point straight into the mapping and stay valid until close()
+class MeshFile
+{
+public:
+	MeshFile() = default;
+	~MeshFile();
+
+	MeshFile(const MeshFile&) = delete;
+	MeshFile& operator=(const MeshFile&) = delete;
+
+	MeshFile(MeshFile&& other) noexcept;
+	MeshFile& operator=(MeshFile&& other) noexcept;
+
+	// Maps and validates the file, returns false and prints the reason on failure
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+
+	MeshKey getKey() const;
+
+	const float* getVertices() const;
+	size_t getVertexCount() const;
+
+	// Indices are 16 or 32-bit depending on getIndexWidth()
+	const void* getIndices() const;
+	size_t getIndexCount() const;
+	size_t getIndexWidth() const;
+
+private:
+	const std::byte* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	MeshFileHeader header {};
+};
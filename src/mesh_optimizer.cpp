@@ -0,0 +1,315 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+static constexpr unsigned int unassigned = UINT_MAX;
+
+static size_t partitionBegin(size_t partition, size_t partitionCount, size_t triangleCount)
+{
+	return partition * triangleCount / partitionCount;
+}
+
+VertexCacheStats MeshOptimizer::measure(ThreadPool& threadPool,
+	std::span<const unsigned int> indices,
+	size_t vertexCount,
+	size_t partitionCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0 || vertexCount == 0)
+		return {};
+
+	partitionCount = std::clamp<size_t>(partitionCount, 1, triangleCount);
+	partitions.resize(partitionCount);
+
+	threadPool.parallelFor(partitionCount, [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end; p++)
+		{
+			const size_t first = partitionBegin(p, partitionCount, triangleCount) * 3;
+			const size_t last = partitionBegin(p + 1, partitionCount, triangleCount) * 3;
+
+			// Ring buffer of the vertices in the cache, oldest first
+			unsigned int cache[vertexCacheSize];
+			std::fill(std::begin(cache), std::end(cache), unassigned);
+
+			size_t head = 0;
+			size_t misses = 0;
+
+			for (size_t i = first; i < last; i++)
+			{
+				if (std::find(std::begin(cache), std::end(cache), indices[i]) != std::end(cache))
+					continue;
+
+				cache[head] = indices[i];
+				head = (head + 1) % vertexCacheSize;
+				misses++;
+			}
+
+			partitions[p].misses = misses;
+		}
+	});
+
+	size_t misses = 0;
+
+	for (size_t p = 0; p < partitionCount; p++)
+		misses += partitions[p].misses;
+
+	VertexCacheStats stats {};
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(triangleCount);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+
+	return stats;
+}
+
+void MeshOptimizer::optimize(ThreadPool& threadPool,
+	std::span<unsigned int> indices,
+	std::span<float> vertices,
+	size_t partitionCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	const size_t vertexCount = vertices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	partitionCount = std::clamp<size_t>(partitionCount, 1, triangleCount);
+	partitions.resize(partitionCount);
+
+	threadPool.parallelFor(partitionCount, [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end; p++)
+		{
+			Partition& partition = partitions[p];
+
+			const size_t first = partitionBegin(p, partitionCount, triangleCount) * 3;
+			const size_t last = partitionBegin(p + 1, partitionCount, triangleCount) * 3;
+
+			// Number the partition's vertices locally in order of appearance, so its scratch
+			// arrays only cover what it uses. A partition has at most one vertex per index,
+			// so a table of at least twice that size stays at most half full
+			const size_t capacity = std::bit_ceil(std::max<size_t>((last - first) * 2, 16));
+			const int shift = 64 - std::countr_zero(capacity);
+
+			partition.tableKeys.assign(capacity, unassigned);
+			partition.tableValues.resize(capacity);
+
+			partition.globalVertices.clear();
+			partition.localIndices.resize(last - first);
+
+			for (size_t i = first; i < last; i++)
+			{
+				const unsigned int vertex = indices[i];
+				size_t slot = static_cast<size_t>((vertex * 0x9E3779B97F4A7C15ull) >> shift);
+
+				while (partition.tableKeys[slot] != unassigned && partition.tableKeys[slot] != vertex)
+					slot = (slot + 1) & (capacity - 1);
+
+				if (partition.tableKeys[slot] == unassigned)
+				{
+					partition.tableKeys[slot] = vertex;
+					partition.tableValues[slot] = static_cast<unsigned int>(partition.globalVertices.size());
+					partition.globalVertices.push_back(vertex);
+				}
+
+				partition.localIndices[i - first] = partition.tableValues[slot];
+			}
+
+			tipsify(partition);
+
+			// Write the triangles back in their new order and note the order vertices are first used in
+			std::vector<bool>& used = partition.emitted;
+			used.assign(partition.globalVertices.size(), false);
+			partition.firstUse.clear();
+
+			size_t output = first;
+
+			for (unsigned int triangle : partition.order)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					unsigned int local = partition.localIndices[triangle * 3 + k];
+					unsigned int global = partition.globalVertices[local];
+
+					indices[output++] = global;
+
+					if (!used[local])
+					{
+						used[local] = true;
+						partition.firstUse.push_back(global);
+					}
+				}
+			}
+		}
+	});
+
+	// Vertices on partition borders belong to the first partition that uses them
+	remap.assign(vertexCount, unassigned);
+	unsigned int nextVertex = 0;
+
+	for (const Partition& partition : partitions)
+	{
+		for (unsigned int vertex : partition.firstUse)
+		{
+			if (remap[vertex] == unassigned)
+				remap[vertex] = nextVertex++;
+		}
+	}
+
+	// Vertices no triangle uses keep their relative order at the end
+	for (unsigned int& index : remap)
+	{
+		if (index == unassigned)
+			index = nextVertex++;
+	}
+
+	reordered.resize(vertices.size());
+
+	threadPool.parallelFor(vertexCount, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			const size_t target = static_cast<size_t>(remap[v]) * 3;
+
+			reordered[target] = vertices[v * 3];
+			reordered[target + 1] = vertices[v * 3 + 1];
+			reordered[target + 2] = vertices[v * 3 + 2];
+		}
+	});
+
+	threadPool.parallelFor(indices.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			indices[i] = remap[indices[i]];
+	});
+
+	// The vertex storage belongs to the caller, so the new order is copied back rather than swapped in
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
+
+void MeshOptimizer::tipsify(Partition& partition)
+{
+	const std::vector<unsigned int>& localIndices = partition.localIndices;
+
+	const size_t vertexCount = partition.globalVertices.size();
+	const size_t triangleCount = localIndices.size() / 3;
+
+	// Triangles around each vertex, stored as offsets into one adjacency array
+	partition.adjacencyOffsets.assign(vertexCount + 1, 0);
+
+	for (unsigned int vertex : localIndices)
+		partition.adjacencyOffsets[vertex + 1]++;
+
+	for (size_t v = 0; v < vertexCount; v++)
+		partition.adjacencyOffsets[v + 1] += partition.adjacencyOffsets[v];
+
+	partition.liveTriangles.resize(vertexCount);
+
+	for (size_t v = 0; v < vertexCount; v++)
+		partition.liveTriangles[v] = partition.adjacencyOffsets[v + 1] - partition.adjacencyOffsets[v];
+
+	// liveTriangles doubles as the fill cursor while building the adjacency
+	partition.adjacency.resize(localIndices.size());
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			unsigned int vertex = localIndices[t * 3 + k];
+			unsigned int slot = partition.adjacencyOffsets[vertex + 1] - partition.liveTriangles[vertex]--;
+			partition.adjacency[slot] = static_cast<unsigned int>(t);
+		}
+	}
+
+	for (size_t v = 0; v < vertexCount; v++)
+		partition.liveTriangles[v] = partition.adjacencyOffsets[v + 1] - partition.adjacencyOffsets[v];
+
+	partition.cacheTime.assign(vertexCount, 0);
+	partition.emitted.assign(triangleCount, false);
+	partition.deadEnds.clear();
+	partition.order.clear();
+
+	const unsigned int cacheSize = static_cast<unsigned int>(vertexCacheSize);
+
+	// Timestamps start past the cache size so that untouched vertices count as out of the cache
+	unsigned int time = cacheSize + 1;
+	unsigned int cursor = 0;
+	unsigned int fanning = 0;
+
+	while (true)
+	{
+		partition.candidates.clear();
+
+		// Emit every remaining triangle around the fanning vertex
+		for (unsigned int a = partition.adjacencyOffsets[fanning]; a < partition.adjacencyOffsets[fanning + 1]; a++)
+		{
+			unsigned int triangle = partition.adjacency[a];
+
+			if (partition.emitted[triangle])
+				continue;
+
+			partition.emitted[triangle] = true;
+			partition.order.push_back(triangle);
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				unsigned int vertex = localIndices[triangle * 3 + k];
+
+				partition.deadEnds.push_back(vertex);
+				partition.candidates.push_back(vertex);
+				partition.liveTriangles[vertex]--;
+
+				if (time - partition.cacheTime[vertex] > cacheSize)
+					partition.cacheTime[vertex] = time++;
+			}
+		}
+
+		// Prefer the candidate that is oldest in the cache but will still be in it
+		// after its remaining triangles are emitted. Any live candidate beats none, so
+		// the best priority starts below zero
+		unsigned int next = unassigned;
+		long long bestPriority = -1;
+
+		for (unsigned int vertex : partition.candidates)
+		{
+			if (partition.liveTriangles[vertex] == 0)
+				continue;
+
+			long long priority = 0;
+
+			if (time - partition.cacheTime[vertex] + 2 * partition.liveTriangles[vertex] <= cacheSize)
+				priority = time - partition.cacheTime[vertex];
+
+			if (priority > bestPriority)
+			{
+				next = vertex;
+				bestPriority = priority;
+			}
+		}
+
+		// Dead end: go back to a recently used vertex, then to the first vertex with triangles left
+		while (next == unassigned && !partition.deadEnds.empty())
+		{
+			unsigned int vertex = partition.deadEnds.back();
+			partition.deadEnds.pop_back();
+
+			if (partition.liveTriangles[vertex] > 0)
+				next = vertex;
+		}
+
+		while (next == unassigned && cursor < vertexCount)
+		{
+			if (partition.liveTriangles[cursor] > 0)
+				next = cursor;
+
+			cursor++;
+		}
+
+		if (next == unassigned)
+			break;
+
+		fanning = next;
+	}
+}
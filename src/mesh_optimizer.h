@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "thread_pool.h"
+
+// Size of the FIFO post-transform cache that the optimizer targets and the statistics simulate
+constexpr size_t vertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+	// Average cache miss ratio, vertex shader runs per triangle (0.5 is the best possible on a closed mesh)
+	float acmr = 0.0f;
+	// Average transform to vertex ratio, vertex shader runs per vertex (1.0 is the best possible)
+	float atvr = 0.0f;
+};
+
+// Reorders triangles for post-transform vertex cache reuse (Tipsify, Sander et al. 2007) and
+// then renumbers vertices in order of first use so that vertex fetches walk memory forwards.
+// The triangles are split into contiguous partitions that are optimized in parallel, which
+// follows the base faces of the generated meshes since each face's triangles stay together
+class MeshOptimizer
+{
+public:
+	MeshOptimizer() = default;
+
+	// Simulates a FIFO cache of vertexCacheSize over each partition
+	VertexCacheStats measure(ThreadPool& threadPool,
+		std::span<const unsigned int> indices,
+		size_t vertexCount,
+		size_t partitionCount);
+
+	void optimize(ThreadPool& threadPool,
+		std::span<unsigned int> indices,
+		std::span<float> vertices,
+		size_t partitionCount);
+
+private:
+	// Scratch buffers of one partition, with vertices renumbered locally
+	struct Partition
+	{
+		// Open addressing table from global to local vertex numbers
+		std::vector<unsigned int> tableKeys {};
+		std::vector<unsigned int> tableValues {};
+
+		std::vector<unsigned int> globalVertices {};
+		std::vector<unsigned int> localIndices {};
+
+		std::vector<unsigned int> adjacencyOffsets {};
+		std::vector<unsigned int> adjacency {};
+		std::vector<unsigned int> liveTriangles {};
+		std::vector<unsigned int> cacheTime {};
+		std::vector<unsigned int> deadEnds {};
+		std::vector<unsigned int> candidates {};
+		std::vector<bool> emitted {};
+
+		std::vector<unsigned int> order {};
+		std::vector<unsigned int> firstUse {};
+
+		size_t misses = 0;
+	};
+
+	void tipsify(Partition& partition);
+
+	std::vector<Partition> partitions {};
+	std::vector<unsigned int> remap {};
+	std::vector<float> reordered {};
+};
@@ -0,0 +1,202 @@
+#include "meshlets.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+void MeshletSet::build(ThreadPool& threadPool,
+	const float* vertices,
+	const unsigned int* indices,
+	size_t vertexCount,
+	size_t triangleCount)
+{
+	meshlets.clear();
+
+	// A vertex belongs to the current meshlet if its stamp is the meshlet's number
+	vertexStamps.assign(vertexCount, UINT_MAX);
+
+	unsigned int meshletVertices = 0;
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* triangle = &indices[t * 3];
+
+		if (meshlets.empty())
+			meshlets.emplace_back();
+
+		const unsigned int current = static_cast<unsigned int>(meshlets.size() - 1);
+
+		unsigned int newVertices = 0;
+
+		for (size_t k = 0; k < 3; k++)
+			newVertices += vertexStamps[triangle[k]] != current;
+
+		if (meshletVertices + newVertices > meshletMaxVertices || meshlets.back().triangleCount == meshletMaxTriangles)
+		{
+			Meshlet& meshlet = meshlets.emplace_back();
+			meshlet.firstTriangle = static_cast<unsigned int>(t);
+
+			meshletVertices = 0;
+		}
+
+		const unsigned int stamp = static_cast<unsigned int>(meshlets.size() - 1);
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			if (vertexStamps[triangle[k]] != stamp)
+			{
+				vertexStamps[triangle[k]] = stamp;
+				meshletVertices++;
+			}
+		}
+
+		meshlets.back().triangleCount++;
+	}
+
+	threadPool.parallelFor(meshlets.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t m = begin; m < end; m++)
+		{
+			Meshlet& meshlet = meshlets[m];
+
+			const size_t first = meshlet.firstTriangle;
+			const size_t last = first + meshlet.triangleCount;
+
+			auto getVertex = [&](unsigned int index) -> glm::vec3
+			{
+				return {vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2]};
+			};
+
+			// Bounding sphere around the center of the bounding box
+			glm::vec3 low = getVertex(indices[first * 3]);
+			glm::vec3 high = low;
+
+			for (size_t i = first * 3; i < last * 3; i++)
+			{
+				glm::vec3 vertex = getVertex(indices[i]);
+
+				low = glm::min(low, vertex);
+				high = glm::max(high, vertex);
+			}
+
+			meshlet.center = (low + high) * 0.5f;
+			meshlet.radius = 0.0f;
+
+			for (size_t i = first * 3; i < last * 3; i++)
+				meshlet.radius = std::max(meshlet.radius, glm::length(getVertex(indices[i]) - meshlet.center));
+
+			// The cone axis is the average triangle normal, its spread the largest angle to any of them
+			glm::vec3 normals[meshletMaxTriangles] {};
+			glm::vec3 axis {};
+
+			for (size_t t = first; t < last; t++)
+			{
+				glm::vec3 a = getVertex(indices[t * 3]);
+				glm::vec3 b = getVertex(indices[t * 3 + 1]);
+				glm::vec3 c = getVertex(indices[t * 3 + 2]);
+
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float length = glm::length(normal);
+
+				normals[t - first] = length > 0.0f ? normal / length : glm::vec3 {};
+				axis += normals[t - first];
+			}
+
+			float axisLength = glm::length(axis);
+			meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3 {};
+
+			float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+
+			for (size_t t = 0; t < meshlet.triangleCount; t++)
+			{
+				// Degenerate triangles have no facing
+				if (normals[t] != glm::vec3 {})
+					minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[t]));
+			}
+
+			meshlet.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		}
+	});
+}
+
+void MeshletSet::clear()
+{
+	meshlets.clear();
+}
+
+bool MeshletSet::empty() const
+{
+	return meshlets.empty();
+}
+
+size_t MeshletSet::size() const
+{
+	return meshlets.size();
+}
+
+size_t MeshletSet::cull(ThreadPool& threadPool,
+	const glm::mat4& modelViewProjection,
+	const glm::vec3& cameraPosition,
+	size_t indexWidth,
+	std::vector<int>& drawCounts,
+	std::vector<const void*>& drawOffsets)
+{
+	// Frustum planes in model space
+	const std::array<glm::vec4, 6> planes = extractFrustumPlanes(modelViewProjection);
+
+	visible.resize(meshlets.size());
+
+	threadPool.parallelFor(meshlets.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t m = begin; m < end; m++)
+		{
+			const Meshlet& meshlet = meshlets[m];
+			bool inside = true;
+
+			for (const glm::vec4& plane : planes)
+				inside = inside && glm::dot(glm::vec3(plane), meshlet.center) + plane.w >= -meshlet.radius;
+
+			// Back-facing from every point of the bounding sphere
+			glm::vec3 toCenter = meshlet.center - cameraPosition;
+			bool backFacing = glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+
+			visible[m] = inside && !backFacing;
+		}
+	});
+
+	drawCounts.clear();
+	drawOffsets.clear();
+
+	size_t visibleTriangles = 0;
+	bool extending = false;
+
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		if (!visible[m])
+		{
+			extending = false;
+			continue;
+		}
+
+		const Meshlet& meshlet = meshlets[m];
+		const int indexCount = static_cast<int>(meshlet.triangleCount * 3);
+
+		// Neighbouring meshlets are neighbours in the index buffer, so runs merge into one draw
+		if (extending)
+		{
+			drawCounts.back() += indexCount;
+		}
+		else
+		{
+			drawCounts.push_back(indexCount);
+			drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(meshlet.firstTriangle) * 3 * indexWidth));
+		}
+
+		visibleTriangles += meshlet.triangleCount;
+		extending = true;
+	}
+
+	return visibleTriangles;
+}
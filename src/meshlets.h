@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+#include "thread_pool.h"
+
+constexpr size_t meshletMaxVertices = 64;
+constexpr size_t meshletMaxTriangles = 124;
+
+// A contiguous run of triangles in the index buffer with bounds for culling
+struct Meshlet
+{
+	unsigned int firstTriangle = 0;
+	unsigned int triangleCount = 0;
+
+	glm::vec3 center {};
+	float radius = 0.0f;
+
+	// Every triangle normal lies within the cone around coneAxis. coneCutoff is the sine
+	// of its half angle, or 1 if the cone is too wide to ever be back-facing
+	glm::vec3 coneAxis {};
+	float coneCutoff = 1.0f;
+};
+
+// Splits an index buffer into meshlets and culls them against a camera each frame
+class MeshletSet
+{
+public:
+	MeshletSet() = default;
+
+	// Greedily groups consecutive triangles, so the index buffer needs no reordering
+	// and follows the locality subdivision and the vertex cache optimizer give it
+	void build(ThreadPool& threadPool,
+		const float* vertices,
+		const unsigned int* indices,
+		size_t vertexCount,
+		size_t triangleCount);
+
+	void clear();
+	bool empty() const;
+	size_t size() const;
+
+	// Rejects meshlets outside the frustum of `modelViewProjection` or facing away from
+	// `cameraPosition`, given in model space. Visible runs are merged into draw ranges of
+	// index counts and byte offsets. Returns the number of visible triangles
+	size_t cull(ThreadPool& threadPool,
+		const glm::mat4& modelViewProjection,
+		const glm::vec3& cameraPosition,
+		size_t indexWidth,
+		std::vector<int>& drawCounts,
+		std::vector<const void*>& drawOffsets);
+
+private:
+	std::vector<Meshlet> meshlets {};
+	std::vector<unsigned int> vertexStamps {};
+	std::vector<unsigned char> visible {};
+};
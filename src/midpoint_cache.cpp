@@ -0,0 +1,94 @@
+#include "midpoint_cache.h"
+
+#include <algorithm>
+#include <bit>
+
+void MidpointCache::reset(size_t edges)
+{
+	// Keep the load factor at or below 50% to keep probe sequences short
+	size_t capacity = std::bit_ceil(std::max<size_t>(edges * 2, 16));
+
+	// Neither call reallocates when a previous reset already needed this much room
+	keys.assign(capacity, emptyKey);
+	values.resize(capacity);
+
+	mask = capacity - 1;
+	count = 0;
+}
+
+std::pair<unsigned int, bool> MidpointCache::insert(unsigned int a, unsigned int b, unsigned int index)
+{
+	if ((count + 1) * 2 > keys.size())
+		grow();
+
+	uint64_t key = makeKey(a, b);
+
+	// Fibonacci hashing spreads the sequential vertex indices over the whole table
+	size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+	while (true)
+	{
+		if (keys[slot] == key)
+			return {values[slot], false};
+
+		if (keys[slot] == emptyKey)
+		{
+			keys[slot] = key;
+			values[slot] = index;
+			count++;
+
+			return {index, true};
+		}
+
+		slot = (slot + 1) & mask;
+	}
+}
+
+unsigned int MidpointCache::find(unsigned int a, unsigned int b) const
+{
+	if (count == 0)
+		return notFound;
+
+	uint64_t key = makeKey(a, b);
+	size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+	while (keys[slot] != emptyKey)
+	{
+		if (keys[slot] == key)
+			return values[slot];
+
+		slot = (slot + 1) & mask;
+	}
+
+	return notFound;
+}
+
+size_t MidpointCache::size() const
+{
+	return count;
+}
+
+uint64_t MidpointCache::makeKey(unsigned int a, unsigned int b)
+{
+	// Edges are undirected, so (a, b) and (b, a) share a key
+	if (a > b)
+		std::swap(a, b);
+
+	return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+void MidpointCache::grow()
+{
+	std::vector<uint64_t> oldKeys = std::move(keys);
+	std::vector<unsigned int> oldValues = std::move(values);
+
+	keys.clear();
+	values.clear();
+	reset(oldKeys.size());
+
+	for (size_t i = 0; i < oldKeys.size(); i++)
+	{
+		if (oldKeys[i] != emptyKey)
+			insert(static_cast<unsigned int>(oldKeys[i] >> 32), static_cast<unsigned int>(oldKeys[i]), oldValues[i]);
+	}
+}
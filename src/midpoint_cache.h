@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Flat open-addressing hash table that maps an undirected edge (a, b)
+// to the index of the vertex created at its midpoint
+class MidpointCache
+{
+public:
+	MidpointCache() = default;
+
+	// Removes all entries and makes room for at least `edges` entries
+	void reset(size_t edges);
+
+	// Returns the index stored for edge (a, b) and false if it already exists,
+	// otherwise stores `index` for the edge and returns it with true
+	std::pair<unsigned int, bool> insert(unsigned int a, unsigned int b, unsigned int index);
+
+	// Returns the index stored for edge (a, b), or notFound
+	unsigned int find(unsigned int a, unsigned int b) const;
+
+	size_t size() const;
+
+	static constexpr unsigned int notFound = UINT32_MAX;
+
+private:
+	static constexpr uint64_t emptyKey = UINT64_MAX;
+
+	static uint64_t makeKey(unsigned int a, unsigned int b);
+
+	void grow();
+
+	std::vector<uint64_t> keys {};
+	std::vector<unsigned int> values {};
+
+	size_t mask = 0;
+	size_t count = 0;
+};
@@ -0,0 +1,164 @@
+#include "midpoint_kernel.h"
+#include "cpu_features.h"
+
+#include <cmath>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+[[maybe_unused]] static void midpointsScalar(
+	const float* ax, const float* ay, const float* az,
+	const float* bx, const float* by, const float* bz,
+	float* outX, float* outY, float* outZ,
+	size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = (ax[i] + bx[i]) * 0.5f;
+		float y = (ay[i] + by[i]) * 0.5f;
+		float z = (az[i] + bz[i]) * 0.5f;
+
+		float scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+
+		outX[i] = x * scale;
+		outY[i] = y * scale;
+		outZ[i] = z * scale;
+	}
+}
+
+#ifdef CPU_FEATURES_X86
+
+static void midpointsSSE(
+	const float* ax, const float* ay, const float* az,
+	const float* bx, const float* by, const float* bz,
+	float* outX, float* outY, float* outZ,
+	size_t count)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 x = _mm_mul_ps(_mm_add_ps(_mm_load_ps(ax + i), _mm_load_ps(bx + i)), half);
+		__m128 y = _mm_mul_ps(_mm_add_ps(_mm_load_ps(ay + i), _mm_load_ps(by + i)), half);
+		__m128 z = _mm_mul_ps(_mm_add_ps(_mm_load_ps(az + i), _mm_load_ps(bz + i)), half);
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+
+		// rsqrt is accurate to ~12 bits, one Newton step brings it close to full float precision.
+		// Its approximation differs between CPU vendors, so results can differ by an ulp or two
+		__m128 scale = _mm_rsqrt_ps(lengthSquared);
+		__m128 halfLength = _mm_mul_ps(half, lengthSquared);
+		scale = _mm_mul_ps(scale, _mm_sub_ps(threeHalves, _mm_mul_ps(halfLength, _mm_mul_ps(scale, scale))));
+
+		_mm_store_ps(outX + i, _mm_mul_ps(x, scale));
+		_mm_store_ps(outY + i, _mm_mul_ps(y, scale));
+		_mm_store_ps(outZ + i, _mm_mul_ps(z, scale));
+	}
+}
+
+TARGET_AVX2 static void midpointsAVX2(
+	const float* ax, const float* ay, const float* az,
+	const float* bx, const float* by, const float* bz,
+	float* outX, float* outY, float* outZ,
+	size_t count)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m256 x = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(ax + i), _mm256_load_ps(bx + i)), half);
+		__m256 y = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(ay + i), _mm256_load_ps(by + i)), half);
+		__m256 z = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(az + i), _mm256_load_ps(bz + i)), half);
+
+		__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+
+		// Same sequence as the SSE kernel (no FMA), so both produce identical results
+		__m256 scale = _mm256_rsqrt_ps(lengthSquared);
+		__m256 halfLength = _mm256_mul_ps(half, lengthSquared);
+		scale = _mm256_mul_ps(scale, _mm256_sub_ps(threeHalves, _mm256_mul_ps(halfLength, _mm256_mul_ps(scale, scale))));
+
+		_mm256_store_ps(outX + i, _mm256_mul_ps(x, scale));
+		_mm256_store_ps(outY + i, _mm256_mul_ps(y, scale));
+		_mm256_store_ps(outZ + i, _mm256_mul_ps(z, scale));
+	}
+}
+
+#endif
+
+struct KernelSelection
+{
+	MidpointKernel kernel;
+	const char* name;
+};
+
+static KernelSelection selectKernel()
+{
+#ifdef CPU_FEATURES_X86
+	if (cpuSupportsAVX2())
+		return {midpointsAVX2, "AVX2"};
+
+	// SSE2 is part of x86-64
+	return {midpointsSSE, "SSE"};
+#else
+	return {midpointsScalar, "Scalar"};
+#endif
+}
+
+static const KernelSelection& getSelection()
+{
+	static const KernelSelection selection = selectKernel();
+	return selection;
+}
+
+MidpointKernel getMidpointKernel()
+{
+	return getSelection().kernel;
+}
+
+const char* getMidpointKernelName()
+{
+	return getSelection().name;
+}
+
+MidpointBatch::MidpointBatch(float* vertices)
+	: vertices(vertices), kernel(getMidpointKernel())
+{
+}
+
+MidpointBatch::~MidpointBatch()
+{
+	flush();
+}
+
+void MidpointBatch::flush()
+{
+	if (count == 0)
+		return;
+
+	// Pad the last step with harmless unit vectors, so every midpoint goes through
+	// the same vector code no matter where the batch boundaries fall
+	size_t padded = (count + midpointKernelWidth - 1) / midpointKernelWidth * midpointKernelWidth;
+
+	for (size_t i = count; i < padded; i++)
+	{
+		ax[i] = bx[i] = 1.0f;
+		ay[i] = by[i] = 0.0f;
+		az[i] = bz[i] = 0.0f;
+	}
+
+	kernel(ax, ay, az, bx, by, bz, outX, outY, outZ, padded);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float* vertex = vertices + destinations[i] * 3;
+
+		vertex[0] = outX[i];
+		vertex[1] = outY[i];
+		vertex[2] = outZ[i];
+	}
+
+	count = 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "cpu_features.h"
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstddef>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+// Number of midpoints the vector kernels process per step
+constexpr size_t midpointKernelWidth = 8;
+
+// Writes normalize((a + b) / 2) for `count` endpoint pairs stored as structure-of-arrays.
+// `count` must be a multiple of midpointKernelWidth
+using MidpointKernel = void (*)(
+	const float* ax, const float* ay, const float* az,
+	const float* bx, const float* by, const float* bz,
+	float* outX, float* outY, float* outZ,
+	size_t count);
+
+// Returns the widest kernel the CPU supports (AVX2, SSE or scalar), detected on first use
+MidpointKernel getMidpointKernel();
+const char* getMidpointKernelName();
+
+// Writes the normalized midpoints of the edges (a, b), (b, c) and (c, a) of one triangle as three
+// consecutive xyz vertices. The corners are already in registers, so the three midpoints go through
+// one SSE step in place rather than being staged in a batch. The lanes use the same rsqrt and Newton
+// step as the batch kernels, so the results match them bit for bit
+inline void writeTriangleMidpoints(float* out, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+#ifdef CPU_FEATURES_X86
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+	// The last lane is the unit vector (1, 0, 0), which keeps it finite
+	__m128 x = _mm_mul_ps(_mm_add_ps(_mm_setr_ps(a.x, b.x, c.x, 1.0f), _mm_setr_ps(b.x, c.x, a.x, 1.0f)), half);
+	__m128 y = _mm_mul_ps(_mm_add_ps(_mm_setr_ps(a.y, b.y, c.y, 0.0f), _mm_setr_ps(b.y, c.y, a.y, 0.0f)), half);
+	__m128 z = _mm_mul_ps(_mm_add_ps(_mm_setr_ps(a.z, b.z, c.z, 0.0f), _mm_setr_ps(b.z, c.z, a.z, 0.0f)), half);
+
+	__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+
+	__m128 scale = _mm_rsqrt_ps(lengthSquared);
+	__m128 halfLength = _mm_mul_ps(half, lengthSquared);
+	scale = _mm_mul_ps(scale, _mm_sub_ps(threeHalves, _mm_mul_ps(halfLength, _mm_mul_ps(scale, scale))));
+
+	x = _mm_mul_ps(x, scale);
+	y = _mm_mul_ps(y, scale);
+	z = _mm_mul_ps(z, scale);
+
+	// Interleave to x0 y0 z0 x1 | y1 z1 x2 y2 | z2
+	__m128 xy01 = _mm_unpacklo_ps(x, y);
+	__m128 xy23 = _mm_unpackhi_ps(x, y);
+
+	_mm_storeu_ps(out, _mm_shuffle_ps(xy01, _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(out + 4, _mm_shuffle_ps(_mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3)), xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+	_mm_store_ss(out + 8, _mm_movehl_ps(z, z));
+#else
+	const glm::vec3 corners[3] {a, b, c};
+
+	for (int k = 0; k < 3; k++)
+	{
+		glm::vec3 midpoint = (corners[k] + corners[(k + 1) % 3]) * 0.5f;
+		float scale = 1.0f / std::sqrt(midpoint.x * midpoint.x + midpoint.y * midpoint.y + midpoint.z * midpoint.z);
+
+		out[k * 3] = midpoint.x * scale;
+		out[k * 3 + 1] = midpoint.y * scale;
+		out[k * 3 + 2] = midpoint.z * scale;
+	}
+#endif
+}
+
+// Stages endpoint pairs in structure-of-arrays layout and writes the normalized
+// midpoints into an interleaved xyz vertex array in batches
+class MidpointBatch
+{
+public:
+	explicit MidpointBatch(float* vertices);
+	~MidpointBatch();
+
+	MidpointBatch(const MidpointBatch&) = delete;
+	MidpointBatch& operator=(const MidpointBatch&) = delete;
+
+	// Queues the midpoint of a and b to be written to vertex `destination`. Called once per
+	// midpoint from other translation units, so it is defined here to be inlined
+	void add(size_t destination, const glm::vec3& a, const glm::vec3& b)
+	{
+		if (count == capacity)
+			flush();
+
+		ax[count] = a.x;
+		ay[count] = a.y;
+		az[count] = a.z;
+		bx[count] = b.x;
+		by[count] = b.y;
+		bz[count] = b.z;
+
+		destinations[count] = destination;
+		count++;
+	}
+
+	// Computes and writes all queued midpoints. Must be called before reading them back
+	void flush();
+
+private:
+	static constexpr size_t capacity = 256;
+
+	float* vertices = nullptr;
+	MidpointKernel kernel = nullptr;
+	size_t count = 0;
+
+	alignas(32) float ax[capacity] {};
+	alignas(32) float ay[capacity] {};
+	alignas(32) float az[capacity] {};
+	alignas(32) float bx[capacity] {};
+	alignas(32) float by[capacity] {};
+	alignas(32) float bz[capacity] {};
+
+	alignas(32) float outX[capacity] {};
+	alignas(32) float outY[capacity] {};
+	alignas(32) float outZ[capacity] {};
+
+	size_t destinations[capacity] {};
+};
@@ -0,0 +1,306 @@
+#include "octa_sphere.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// Equator vertices of the octahedron as (x, z), in the order the rings run through them
+static constexpr float ringAxes[4][2] = {{1.0f, 0.0f}, {0.0f, -1.0f}, {-1.0f, 0.0f}, {0.0f, 1.0f}};
+
+// Largest r with r * r <= value
+static int64_t integerSqrt(int64_t value)
+{
+	int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+
+	while (root * root > value)
+		root--;
+
+	while ((root + 1) * (root + 1) <= value)
+		root++;
+
+	return root;
+}
+
+// Ring r runs through the points at |x| + |z| = min(r, 2 * segments - r) / segments,
+// from +x towards -z
+struct OctaRings
+{
+	int64_t segments;
+	int64_t total;
+
+	// Vertices per octahedron face edge on the ring
+	int64_t width(int64_t ring) const
+	{
+		return std::min(ring, 2 * segments - ring);
+	}
+
+	// Index of the first vertex of `ring`
+	int64_t start(int64_t ring) const
+	{
+		if (ring == 0)
+			return 0;
+
+		if (ring <= segments)
+			return 1 + 2 * ring * (ring - 1);
+
+		int64_t south = 2 * segments - ring;
+		return total - 1 - 2 * south * (south + 1);
+	}
+
+	// Ring of vertex `index` counted from the nearer pole, inverting start() for the north half
+	static int64_t ringFromPole(int64_t index)
+	{
+		if (index == 0)
+			return 0;
+
+		// 1 + 2r(r - 1) <= index gives r <= (1 + sqrt(2 * index - 1)) / 2
+		int64_t ring = (1 + integerSqrt(2 * index - 1)) / 2;
+
+		while (1 + 2 * (ring + 1) * ring <= index)
+			ring++;
+
+		while (ring > 0 && 1 + 2 * ring * (ring - 1) > index)
+			ring--;
+
+		return ring;
+	}
+
+	int64_t ring(int64_t index) const
+	{
+		if (index < start(segments + 1))
+			return ringFromPole(index);
+
+		return 2 * segments - ringFromPole(total - 1 - index);
+	}
+
+	// Index of the k-th vertex of `ring`, wrapping around
+	unsigned int vertex(int64_t ring, int64_t k) const
+	{
+		int64_t w = width(ring);
+
+		if (w == 0)
+			return static_cast<unsigned int>(start(ring));
+
+		return static_cast<unsigned int>(start(ring) + k % (4 * w));
+	}
+};
+
+static OctaRings getRings(unsigned int segments)
+{
+	segments = std::max(segments, 1u);
+	return {static_cast<int64_t>(segments), static_cast<int64_t>(getOctaSphereVertexCount(segments))};
+}
+
+size_t getOctaSphereVertexCount(unsigned int segments)
+{
+	size_t n = std::max(segments, 1u);
+	return 4 * n * n + 2;
+}
+
+size_t getOctaSphereTriangleCount(unsigned int segments)
+{
+	size_t n = std::max(segments, 1u);
+	return 8 * n * n;
+}
+
+glm::vec3 getOctaSphereVertex(unsigned int segments, size_t index)
+{
+	const OctaRings rings = getRings(segments);
+	const float n = static_cast<float>(rings.segments);
+
+	const int64_t ring = rings.ring(static_cast<int64_t>(index));
+	const int64_t w = rings.width(ring);
+	const float y = static_cast<float>(rings.segments - ring) / n;
+
+	if (w == 0)
+		return {0.0f, y, 0.0f};
+
+	// Position along the face edge between two equator vertices
+	const int64_t k = static_cast<int64_t>(index) - rings.start(ring);
+	const int64_t quadrant = k / w;
+	const int64_t t = k % w;
+
+	const float a = static_cast<float>(w - t) / n;
+	const float b = static_cast<float>(t) / n;
+
+	const float* from = ringAxes[quadrant];
+	const float* to = ringAxes[(quadrant + 1) & 3];
+
+	return glm::normalize(glm::vec3(a * from[0] + b * to[0], y, a * from[1] + b * to[1]));
+}
+
+void getOctaSphereTriangle(unsigned int segments, size_t triangle, unsigned int* corners)
+{
+	const OctaRings rings = getRings(segments);
+	const int64_t faceSize = rings.segments * rings.segments;
+
+	const int64_t face = static_cast<int64_t>(triangle) / faceSize;
+	const int64_t local = static_cast<int64_t>(triangle) % faceSize;
+
+	// The band between the rings `band` and `band + 1` steps from the pole has 2 * band + 1
+	// triangles on each face, alternating between pointing to and away from the pole
+	const int64_t band = integerSqrt(local);
+	const int64_t offset = local - band * band;
+	const int64_t t = offset / 2;
+
+	const int64_t quadrant = face & 3;
+	const bool south = face >= 4;
+
+	const int64_t inner = south ? 2 * rings.segments - band : band;
+	const int64_t outer = south ? inner - 1 : inner + 1;
+
+	const int64_t innerFirst = quadrant * band + t;
+	const int64_t outerFirst = quadrant * (band + 1) + t;
+
+	if (offset % 2 == 0)
+	{
+		corners[0] = rings.vertex(outer, outerFirst);
+		corners[1] = rings.vertex(outer, outerFirst + 1);
+		corners[2] = rings.vertex(inner, innerFirst);
+	}
+	else
+	{
+		corners[0] = rings.vertex(inner, innerFirst);
+		corners[1] = rings.vertex(outer, outerFirst + 1);
+		corners[2] = rings.vertex(inner, innerFirst + 1);
+	}
+
+	// The southern faces mirror the northern ones, which flips the winding
+	if (south)
+		std::swap(corners[1], corners[2]);
+}
+
+void generateOctaSphere(ThreadPool& threadPool, unsigned int segments, float* vertices, unsigned int* indices)
+{
+	const OctaRings rings = getRings(segments);
+	const int64_t n = rings.segments;
+
+	// Same results as getOctaSphereVertex and getOctaSphereTriangle, but a ring or band at a time
+	// so the per-index square roots and divisions drop out of the inner loops
+	threadPool.parallelFor(static_cast<size_t>(2 * n + 1), [&](size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; r++)
+		{
+			const int64_t ring = static_cast<int64_t>(r);
+			const int64_t w = rings.width(ring);
+			const float y = static_cast<float>(n - ring) / static_cast<float>(n);
+
+			float* vertex = vertices + rings.start(ring) * 3;
+
+			if (w == 0)
+			{
+				vertex[0] = 0.0f;
+				vertex[1] = y;
+				vertex[2] = 0.0f;
+				continue;
+			}
+
+			for (int quadrant = 0; quadrant < 4; quadrant++)
+			{
+				const float* from = ringAxes[quadrant];
+				const float* to = ringAxes[(quadrant + 1) & 3];
+
+				for (int64_t t = 0; t < w; t++)
+				{
+					const float a = static_cast<float>(w - t) / static_cast<float>(n);
+					const float b = static_cast<float>(t) / static_cast<float>(n);
+
+					glm::vec3 point = glm::normalize(glm::vec3(a * from[0] + b * to[0], y, a * from[1] + b * to[1]));
+
+					vertex[0] = point.x;
+					vertex[1] = point.y;
+					vertex[2] = point.z;
+					vertex += 3;
+				}
+			}
+		}
+	});
+
+	// One task per band of each face
+	threadPool.parallelFor(static_cast<size_t>(8 * n), [&](size_t begin, size_t end)
+	{
+		for (size_t task = begin; task < end; task++)
+		{
+			const int64_t face = static_cast<int64_t>(task) / n;
+			const int64_t band = static_cast<int64_t>(task) % n;
+
+			const int64_t quadrant = face & 3;
+			const bool south = face >= 4;
+
+			const int64_t inner = south ? 2 * n - band : band;
+			const int64_t outer = south ? inner - 1 : inner + 1;
+
+			// Second and third corners swap on the mirrored southern faces
+			const int second = south ? 2 : 1;
+			const int third = south ? 1 : 2;
+
+			unsigned int* triangle = indices + (face * n * n + band * band) * 3;
+
+			for (int64_t t = 0; t <= band; t++)
+			{
+				triangle[0] = rings.vertex(outer, quadrant * (band + 1) + t);
+				triangle[second] = rings.vertex(outer, quadrant * (band + 1) + t + 1);
+				triangle[third] = rings.vertex(inner, quadrant * band + t);
+				triangle += 3;
+
+				if (t == band)
+					break;
+
+				triangle[0] = rings.vertex(inner, quadrant * band + t);
+				triangle[second] = rings.vertex(outer, quadrant * (band + 1) + t + 1);
+				triangle[third] = rings.vertex(inner, quadrant * band + t + 1);
+				triangle += 3;
+			}
+		}
+	});
+}
+
+double getTriangleSphereError(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+{
+	const glm::dvec3 corner[3] {a, b, c};
+
+	for (int j = 0; j < 3; j++)
+	{
+		const glm::dvec3& next = corner[(j + 1) % 3];
+		const glm::dvec3& last = corner[(j + 2) % 3];
+
+		if (glm::dot(next - corner[j], last - corner[j]) < 0.0)
+			return std::max(1.0 - glm::length((next + last) * 0.5), 0.0);
+	}
+
+	glm::dvec3 normal = glm::cross(b - a, c - a);
+	double length = glm::length(normal);
+	double distance = length > 0.0 ? std::abs(glm::dot(normal, a)) / length : glm::length(a);
+
+	return std::max(1.0 - distance, 0.0);
+}
+
+double getMaxSphereError(ThreadPool& threadPool, const float* vertices, const unsigned int* indices, size_t triangleCount)
+{
+	// Non-negative doubles order the same way as their bits
+	std::atomic<uint64_t> maxErrorBits {0};
+
+	threadPool.parallelFor(triangleCount, [&](size_t begin, size_t end)
+	{
+		double maxError = 0.0;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::dvec3 corner[3];
+
+			for (int j = 0; j < 3; j++)
+			{
+				const float* v = vertices + indices[i * 3 + j] * 3;
+				corner[j] = {v[0], v[1], v[2]};
+			}
+
+			maxError = std::max(maxError, getTriangleSphereError(corner[0], corner[1], corner[2]));
+		}
+
+		atomicMax(maxErrorBits, std::bit_cast<uint64_t>(maxError));
+	});
+
+	return std::bit_cast<double>(maxErrorBits.load());
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "thread_pool.h"
+
+// Octahedron with `segments` divisions per edge, projected onto the sphere. Vertices lie on
+// 2 * segments + 1 rings of the octahedral map around the y axis, ring r holding 4 * min(r, 2 * segments - r)
+// vertices (one at each pole). Both vertices and triangles follow from their index alone, so either
+// can be generated in any order or on the GPU from gl_VertexID
+
+size_t getOctaSphereVertexCount(unsigned int segments);
+size_t getOctaSphereTriangleCount(unsigned int segments);
+
+glm::vec3 getOctaSphereVertex(unsigned int segments, size_t index);
+// Writes the three vertex indices of `triangle`, counter-clockwise seen from outside.
+// Triangles are grouped by octahedron face, segments^2 per face
+void getOctaSphereTriangle(unsigned int segments, size_t triangle, unsigned int* corners);
+
+// Writes every vertex as an xyz triple and every triangle as three indices
+void generateOctaSphere(ThreadPool& threadPool, unsigned int segments, float* vertices, unsigned int* indices);
+
+// Largest distance between the unit sphere and a triangle whose corners lie on it. The triangle
+// comes closest to the center at its circumcenter, or at the middle of its longest edge when it is obtuse
+double getTriangleSphereError(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c);
+
+// Largest getTriangleSphereError over the triangles of a mesh
+double getMaxSphereError(ThreadPool& threadPool, const float* vertices, const unsigned int* indices, size_t triangleCount);
@@ -0,0 +1,71 @@
+#include "octahedral.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Sign that maps 0 to 1, so points on the fold lines stay on the right side
+static float signNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+OctahedralVertex encodeOctahedral(const glm::vec3& vertex)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+	const float invL1 = 1.0f / (std::abs(vertex.x) + std::abs(vertex.y) + std::abs(vertex.z));
+
+	float u = vertex.x * invL1;
+	float v = vertex.y * invL1;
+
+	if (vertex.z < 0.0f)
+	{
+		float foldedU = (1.0f - std::abs(v)) * signNotZero(u);
+		float foldedV = (1.0f - std::abs(u)) * signNotZero(v);
+
+		u = foldedU;
+		v = foldedV;
+	}
+
+	const float scaledU = std::clamp(u, -1.0f, 1.0f) * octahedralScale;
+	const float scaledV = std::clamp(v, -1.0f, 1.0f) * octahedralScale;
+
+	const float baseU = std::floor(scaledU);
+	const float baseV = std::floor(scaledV);
+
+	OctahedralVertex best {};
+	float bestError = 2.0f;
+
+	// Rounding each coordinate on its own isn't always the closest point on the sphere
+	for (int corner = 0; corner < 4; corner++)
+	{
+		const float candidateU = std::clamp(baseU + static_cast<float>(corner & 1), -octahedralScale, octahedralScale);
+		const float candidateV = std::clamp(baseV + static_cast<float>(corner >> 1), -octahedralScale, octahedralScale);
+
+		OctahedralVertex candidate {static_cast<int16_t>(candidateU), static_cast<int16_t>(candidateV)};
+		float error = glm::length(decodeOctahedral(candidate) - vertex);
+
+		if (error < bestError)
+		{
+			best = candidate;
+			bestError = error;
+		}
+	}
+
+	return best;
+}
+
+glm::vec3 decodeOctahedral(OctahedralVertex encoded)
+{
+	const float u = static_cast<float>(encoded.x) / octahedralScale;
+	const float v = static_cast<float>(encoded.y) / octahedralScale;
+
+	glm::vec3 vertex {u, v, 1.0f - std::abs(u) - std::abs(v)};
+
+	if (vertex.z < 0.0f)
+	{
+		vertex.x = (1.0f - std::abs(v)) * signNotZero(u);
+		vertex.y = (1.0f - std::abs(u)) * signNotZero(v);
+	}
+
+	return glm::normalize(vertex);
+}
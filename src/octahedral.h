@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// A unit vector stored as two signed 16-bit coordinates on the unfolded octahedron.
+// Dividing by octahedralScale gives coordinates in [-1, 1]
+struct OctahedralVertex
+{
+	int16_t x = 0;
+	int16_t y = 0;
+};
+
+constexpr float octahedralScale = 32767.0f;
+
+// Picks whichever of the four surrounding grid points decodes closest to `vertex`
+OctahedralVertex encodeOctahedral(const glm::vec3& vertex);
+
+// Matches the decode in shaders/basic.vs
+glm::vec3 decodeOctahedral(OctahedralVertex encoded);
@@ -1,201 +1,442 @@
 #include "sphere.h"
+#include "midpoint_kernel.h"
+#include "baked_icosphere.h"
 
 #include <GL/glew.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <numbers>
 #include <cmath>
+#include <chrono>
+#include <atomic>
+#include <bit>
+#include <iostream>
 
 constexpr float pi = std::numbers::pi;
 
 void Sphere::init()
 {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	glGenVertexArrays(1, &buffers.VAO);
+	glGenBuffers(1, &buffers.VBO);
+	glGenBuffers(1, &buffers.EBO);
 }
 
 void Sphere::generateIcosphere()
 {
-	// Source: https://en.wikipedia.org/wiki/Regular_icosahedron#Construction
-	const float phi = (1.0f + std::sqrt(5.0f)) / 2.0f;
-	const float scale = 1.0f / std::sqrt(phi * phi + 1.0f);
-	const float scaledPhi = phi * scale;
+	parkMesh();
+	resetMeshStorage();
+	loadBakedIcosphere(0);
 
-	vertices.clear();
-	vertices.reserve(12 * 3);
-
-	indices.clear();
-	indices.reserve(20 * 3);
-
-	addVertex(-scale, scaledPhi, 0);
-	addVertex(scale, scaledPhi, 0);
-	addVertex(-scale, -scaledPhi, 0);
-	addVertex(scale, -scaledPhi, 0);
-	addVertex(0, -scale, scaledPhi);
-	addVertex(0, scale, scaledPhi);
-	addVertex(0, -scale, -scaledPhi);
-	addVertex(0, scale, -scaledPhi);
-	addVertex(scaledPhi, 0, -scale);
-	addVertex(scaledPhi, 0, scale);
-	addVertex(-scaledPhi, 0, -scale);
-	addVertex(-scaledPhi, 0, scale);
-
-	addIndices(0, 11, 5);
-	addIndices(0, 5, 1);
-	addIndices(0, 1, 7);
-	addIndices(0, 7, 10);
-	addIndices(0, 10, 11);
-	addIndices(1, 5, 9);
-	addIndices(5, 11, 4);
-	addIndices(11, 10, 2);
-	addIndices(10, 7, 6);
-	addIndices(7, 1, 8);
-	addIndices(3, 9, 4);
-	addIndices(3, 4, 2);
-	addIndices(3, 2, 6);
-	addIndices(3, 6, 8);
-	addIndices(3, 8, 9);
-	addIndices(4, 9, 5);
-	addIndices(2, 4, 11);
-	addIndices(6, 2, 10);
-	addIndices(8, 6, 7);
-	addIndices(9, 8, 1);
-
-	subdivisions = 0;
 	type = SphereType::IcoSphere;
+	buffersDirty = true;
 }
 
-void Sphere::generateCubesphere()
+void Sphere::generateCubesphere(unsigned int resolution, bool warp)
 {
-	// Ensure all points have a constant distance of 1 to the origin
-	float position = 1.0f / std::sqrt(3.0f);
+	resolution = std::max(resolution, 1u);
+
+	const unsigned int n = resolution;
+	const size_t edgePoints = n - 1;
+
+	// 8 corners, n - 1 points on each of the 12 edges and (n - 1)^2 inside each of the 6 faces
+	const size_t edgeStart = 8;
+	const size_t faceStart = edgeStart + 12 * edgePoints;
+	const size_t numVertices = faceStart + 6 * edgePoints * edgePoints;
+
+	parkMesh();
+	resetMeshStorage();
+
+	vertices.resize(numVertices * 3);
+	indices.resize(static_cast<size_t>(6) * n * n * 2 * 3);
+
+	// Grid points are integer coordinates in [0, n]^3 on the surface of the cube.
+	// Each point gets its index from which of its coordinates lie on the boundary,
+	// so points on shared edges and corners get the same index from every face
+	auto gridIndex = [n, edgeStart, faceStart, edgePoints](const unsigned int p[3]) -> unsigned int
+	{
+		bool high[3] {p[0] == n, p[1] == n, p[2] == n};
+		bool boundary[3] {p[0] == 0 || high[0], p[1] == 0 || high[1], p[2] == 0 || high[2]};
+
+		int numBoundary = boundary[0] + boundary[1] + boundary[2];
+
+		if (numBoundary == 3)
+			return high[0] | (high[1] << 1) | (high[2] << 2);
+
+		if (numBoundary == 2)
+		{
+			int axis = !boundary[0] ? 0 : (!boundary[1] ? 1 : 2);
+			int edge = axis * 4 + high[(axis + 1) % 3] + high[(axis + 2) % 3] * 2;
+
+			return static_cast<unsigned int>(edgeStart + edge * edgePoints + p[axis] - 1);
+		}
+
+		int axis = boundary[0] ? 0 : (boundary[1] ? 1 : 2);
+		int face = axis * 2 + high[axis];
+		unsigned int u = p[(axis + 1) % 3];
+		unsigned int v = p[(axis + 2) % 3];
+
+		return static_cast<unsigned int>(faceStart + face * edgePoints * edgePoints + (u - 1) * edgePoints + (v - 1));
+	};
+
+	// Positions only depend on the grid coordinates, so a point shared by several faces
+	// gets the same value from each of them
+	auto gridPosition = [n, warp](const unsigned int p[3]) -> glm::vec3
+	{
+		glm::vec3 point {};
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float coordinate = -1.0f + 2.0f * static_cast<float>(p[axis]) / static_cast<float>(n);
 
-	vertices = {
-		-position, -position, -position,
-		 position, -position, -position,
-		 position,  position, -position,
-		-position,  position, -position,
-		-position, -position,  position,
-		 position, -position,  position,
-		 position,  position,  position,
-		-position,  position,  position
+			// Spacing points by equal angles instead of equal distances evens out the
+			// triangles that would otherwise shrink towards the face corners
+			if (warp)
+				coordinate = std::tan(coordinate * 0.25f * pi);
+
+			point[axis] = coordinate;
+		}
+
+		return glm::normalize(point);
 	};
 
-	indices = {
-		0, 1, 3, 3, 1, 2,
-		1, 5, 2, 2, 5, 6,
-		5, 4, 6, 6, 4, 7,
-		4, 0, 7, 7, 0, 3,
-		3, 2, 7, 7, 2, 6,
-		4, 5, 0, 0, 5, 1
+	auto facePoint = [n](int face, unsigned int u, unsigned int v, unsigned int p[3])
+	{
+		int axis = face / 2;
+
+		p[axis] = (face % 2 == 1) ? n : 0;
+		p[(axis + 1) % 3] = u;
+		p[(axis + 2) % 3] = v;
 	};
 
+	// Corners and edges are few, fill them while walking the border of every face
+	for (int face = 0; face < 6; face++)
+	{
+		for (unsigned int k = 0; k < n; k++)
+		{
+			const unsigned int border[4][2] {{k, 0}, {n, k}, {n - k, n}, {0, n - k}};
+
+			for (const auto& [u, v] : border)
+			{
+				unsigned int p[3] {};
+				facePoint(face, u, v, p);
+				setVertex(gridIndex(p), gridPosition(p));
+			}
+		}
+	}
+
+	threadPool.parallelFor(6, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			int faceId = static_cast<int>(face);
+
+			for (unsigned int u = 1; u < n; u++)
+			{
+				for (unsigned int v = 1; v < n; v++)
+				{
+					unsigned int p[3] {};
+					facePoint(faceId, u, v, p);
+					setVertex(gridIndex(p), gridPosition(p));
+				}
+			}
+
+			// u x v points along the face axis, so faces on the low side flip their winding to face outwards
+			bool flip = face % 2 == 0;
+			size_t triangle = face * n * n * 2;
+
+			for (unsigned int u = 0; u < n; u++)
+			{
+				for (unsigned int v = 0; v < n; v++)
+				{
+					unsigned int corner[4] {};
+					const unsigned int quad[4][2] {{u, v}, {u + 1, v}, {u + 1, v + 1}, {u, v + 1}};
+
+					for (int k = 0; k < 4; k++)
+					{
+						unsigned int p[3] {};
+						facePoint(faceId, quad[k][0], quad[k][1], p);
+						corner[k] = gridIndex(p);
+					}
+
+					if (flip)
+						std::swap(corner[1], corner[3]);
+
+					// Split quads along the diagonal pointing away from the face center,
+					// which keeps the face symmetric
+					bool lowU = 2 * u + 1 < n;
+					bool lowV = 2 * v + 1 < n;
+
+					if (lowU == lowV)
+					{
+						setIndices(triangle++, corner[0], corner[1], corner[2]);
+						setIndices(triangle++, corner[0], corner[2], corner[3]);
+					}
+					else
+					{
+						setIndices(triangle++, corner[0], corner[1], corner[3]);
+						setIndices(triangle++, corner[1], corner[2], corner[3]);
+					}
+				}
+			}
+		}
+	});
+
+	cubeResolution = resolution;
+	cubeWarp = warp;
+
 	subdivisions = 0;
 	type = SphereType::CubeSphere;
+	buffersDirty = true;
 }
 
 void Sphere::generateSectorsphere(unsigned int sectors, unsigned int stacks)
 {
-	vertices.clear();
-	indices.clear();
+	sectors = std::max(sectors, 1u);
+	stacks = std::max(stacks, 1u);
+
+	parkMesh();
+	resetMeshStorage();
+
+	const size_t rowLength = sectors + 1;
+	const size_t numVertices = rowLength * (stacks + 1);
+
+	// The band between stack i and i + 1 has sectors quads, but the bands touching
+	// the poles only need one triangle per quad
+	const size_t numTriangles = stacks > 1 ? static_cast<size_t>(sectors) * 2 * (stacks - 1) : 0;
 
-	unsigned int numVertices = (sectors + 1) * (stacks + 1);
+	vertices.resize(numVertices * 3);
+	indices.resize(numTriangles * 3);
 
-	for (int i = 0; i <= stacks; i++)
+	// Only stacks + sectors distinct angles exist, so their sines and cosines are computed once
+	scratchArena.reset();
+	std::span<float> trigTable = scratchArena.allocate<float>((stacks + 1) * 2 + rowLength * 2);
+
+	float* stackCos = trigTable.data();
+	float* stackSin = stackCos + stacks + 1;
+	float* sectorCos = stackSin + stacks + 1;
+	float* sectorSin = sectorCos + rowLength;
+
+	for (unsigned int i = 0; i <= stacks; i++)
 	{
 		// Stack angles range from pi/2 to -pi/2
 		const float phi = 0.5f * pi - pi * (static_cast<float>(i) / static_cast<float>(stacks));
 
-		unsigned int stackIndex = i * (sectors + 1);
-		unsigned int nextStackIndex = (i + 1) * (sectors + 1);
+		stackCos[i] = std::cos(phi);
+		stackSin[i] = std::sin(phi);
+	}
+
+	for (unsigned int j = 0; j <= sectors; j++)
+	{
+		// Sector angles range from 0 to 2pi
+		const float theta = 2.0f * pi * (static_cast<float>(j) / static_cast<float>(sectors));
+
+		sectorCos[j] = std::cos(theta);
+		sectorSin[j] = std::sin(theta);
+	}
+
+	// Each row is the sector circle scaled by the stack radius and lifted to the stack height
+	threadPool.parallelFor(stacks + 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const float radius = stackCos[i];
+			const float height = stackSin[i];
+
+			float* row = &vertices[i * rowLength * 3];
+
+			for (size_t j = 0; j < rowLength; j++)
+			{
+				row[j * 3] = radius * sectorCos[j];
+				row[j * 3 + 1] = height;
+				row[j * 3 + 2] = radius * sectorSin[j];
+			}
+		}
+	});
 
-		for (int j = 0; j <= sectors; j++)
+	// Band i starts after the single-triangle top band and i - 1 full bands
+	threadPool.parallelFor(stacks, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
 		{
-			// Sector angles range from 0 to 2pi 
-			const float theta = 2.0f * pi * (static_cast<float>(j) / static_cast<float>(sectors));
+			const bool upper = i != 0;
+			const bool lower = i != stacks - 1;
 
-			glm::vec3 vertex {};
-			vertex.x = std::cos(phi) * std::cos(theta);
-			vertex.y = std::sin(phi);
-			vertex.z = std::cos(phi) * std::sin(theta);
+			size_t triangle = i == 0 ? 0 : static_cast<size_t>(sectors) * (2 * i - 1);
 
-			addVertex(vertex);
+			unsigned int stackIndex = static_cast<unsigned int>(i * rowLength);
+			unsigned int nextStackIndex = static_cast<unsigned int>((i + 1) * rowLength);
 
-			if (i != 0 && nextStackIndex < numVertices)
-				addIndices(stackIndex, stackIndex + 1, nextStackIndex);
+			for (unsigned int j = 0; j < sectors; j++)
+			{
+				if (upper)
+					setIndices(triangle++, stackIndex, stackIndex + 1, nextStackIndex);
 
-			if (i != stacks - 1 && nextStackIndex + 1 < numVertices)
-				addIndices(nextStackIndex, nextStackIndex + 1, stackIndex + 1);
+				// Both triangles of a quad wind counter-clockwise seen from outside
+				if (lower)
+					setIndices(triangle++, nextStackIndex, stackIndex + 1, nextStackIndex + 1);
 
-			stackIndex++;
-			nextStackIndex++;
+				stackIndex++;
+				nextStackIndex++;
+			}
 		}
-	}
+	});
 
 	this->sectors = sectors;
 	this->stacks = stacks;
 
 	subdivisions = 0;
 	type = SphereType::SectorSphere;
+	buffersDirty = true;
+}
+
+void Sphere::generateAdaptiveIcosphere()
+{
+	parkMesh();
+	resetMeshStorage();
+
+	adaptiveRefiner.reset(vertices);
+	BakedIcosphere base = getBakedIcosphere(0);
+	indices.assign(base.indices, base.indices + base.triangleCount * 3);
+
+	// The subdivision level is the deepest the refinement may go
+	if (type != SphereType::AdaptiveIcoSphere)
+		subdivisions = adaptiveRefiner.getMaxLevel();
+
+	type = SphereType::AdaptiveIcoSphere;
+	adaptiveDirty = true;
+	buffersDirty = true;
+}
+
+void Sphere::generateFibonacciSphere(size_t pointCount)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	parkMesh();
+	resetMeshStorage();
+
+	fibonacciPoints = std::max<size_t>(pointCount, 1);
+
+	vertices.resize(fibonacciPoints * 3);
+	indices.clear();
+
+	generateFibonacciPoints(threadPool, fibonacciPoints, vertices.data());
+
+	subdivisions = 0;
+	type = SphereType::FibonacciSphere;
+	buffersDirty = true;
+
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void Sphere::generateHealpixSphere(unsigned int nside)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	parkMesh();
+	resetMeshStorage();
+
+	unsigned int order = std::min(static_cast<unsigned int>(std::bit_width(std::max(nside, 1u))) - 1, healpixMaxOrder);
+	buildHealpix(order);
+
+	subdivisions = order;
+	type = SphereType::HEALPix;
+	buffersDirty = true;
+
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void Sphere::generateOctasphere(unsigned int resolution)
+{
+	parkMesh();
+	resetMeshStorage();
+
+	octaResolution = std::max(resolution, 1u);
+	buildOctasphere(octaResolution);
+
+	subdivisions = 0;
+	type = SphereType::OctaSphere;
+	buffersDirty = true;
+}
+
+size_t Sphere::getFibonacciPointCount() const
+{
+	return fibonacciPoints;
+}
+
+size_t Sphere::findNearestPoint(glm::vec3 position) const
+{
+	glm::vec3 direction = glm::vec3(glm::inverse(getModelMatrix()) * glm::vec4(position, 1.0f));
+
+	if (glm::length(direction) == 0.0f)
+		return 0;
+
+	return findNearestFibonacciPoint(glm::normalize(direction), fibonacciPoints);
+}
+
+unsigned int Sphere::getHealpixNside() const
+{
+	return 1u << subdivisions;
+}
+
+uint32_t Sphere::findPixel(glm::vec3 position) const
+{
+	glm::vec3 direction = glm::vec3(glm::inverse(getModelMatrix()) * glm::vec4(position, 1.0f));
+	return healpixVec2Pix(subdivisions, direction);
 }
 
 void Sphere::subdivide(unsigned int newSubdivisions)
 {
-	if (newSubdivisions == subdivisions)
+	// Points have no triangles to split, their density is set by the point count
+	if (newSubdivisions == subdivisions || type == SphereType::FibonacciSphere)
 		return;
 
-	if (newSubdivisions < subdivisions)
+	// The adaptive icosphere only changes its refinement limit
+	if (type == SphereType::AdaptiveIcoSphere)
 	{
-		if (type == SphereType::IcoSphere)
-			generateIcosphere();
-		else if (type == SphereType::CubeSphere)
-			generateCubesphere();
-		else if (type == SphereType::SectorSphere)
-			generateSectorsphere(sectors, stacks);
+		buildLevel(newSubdivisions);
+		return;
 	}
 
-	for (unsigned int i = subdivisions; i < newSubdivisions; i++)
-	{
-		std::vector<float> oldVertices = vertices;
-		std::vector<unsigned int> oldIndices = indices;
-
-		vertices.clear();
-		indices.clear();
+	auto startTime = std::chrono::steady_clock::now();
 
-		int index = 0;
+	// Going up continues from the mapped mesh, which needs it in memory
+	if (mappedFile.isOpen() && newSubdivisions > subdivisions)
+		copyMapping();
 
-		// Loop through each triangle (every 3 indices)
-		for (int j = 0; j < oldIndices.size(); j += 3)
-		{
-			size_t v1Pos = oldIndices[j] * 3;
-			size_t v2Pos = oldIndices[j + 1] * 3;
-			size_t v3Pos = oldIndices[j + 2] * 3;
+	if (meshCache.getBudget() > 0)
+	{
+		MeshKey target = getMeshKey();
+		target.level = newSubdivisions;
 
-			glm::vec3 v1 {oldVertices[v1Pos], oldVertices[v1Pos + 1], oldVertices[v1Pos + 2]};
-			glm::vec3 v2 {oldVertices[v2Pos], oldVertices[v2Pos + 1], oldVertices[v2Pos + 2]};
-			glm::vec3 v3 {oldVertices[v3Pos], oldVertices[v3Pos + 1], oldVertices[v3Pos + 2]};
+		parkMesh();
 
-			glm::vec3 mid1 = findMidpoint(v1, v2);
-			glm::vec3 mid2 = findMidpoint(v2, v3);
-			glm::vec3 mid3 = findMidpoint(v3, v1);
+		if (!restoreMesh(target))
+		{
+			// Continue from the closest cached level below the target, or from the base shape
+			unsigned int cachedLevel = 0;
 
-			addVertex(mid1); // 0
-			addVertex(mid2); // 1
-			addVertex(mid3); // 2
-			addVertex(v1);   // 3
-			addVertex(v2);   // 4
-			addVertex(v3);   // 5
+			// HEALPix and octahedron grids are always built from scratch, so a lower level is no help
+			bool continuable = subdivisionMode != SubdivisionMode::Direct &&
+				type != SphereType::HEALPix && type != SphereType::OctaSphere;
 
-			addIndices(index, index + 2, index + 1);
-			addIndices(index + 1, index + 2, index + 5);
-			addIndices(index, index + 1, index + 4);
-			addIndices(index, index + 2, index + 3);
+			if (continuable && meshCache.copyBelow(target, vertices, indices, cachedLevel))
+				subdivisions = cachedLevel;
+			else
+				generateBase();
 
-			index += 6;
+			buildLevel(newSubdivisions);
 		}
 	}
+	else
+	{
+		buildLevel(newSubdivisions);
+	}
 
-	subdivisions = newSubdivisions;
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
 }
 
 unsigned int Sphere::getSubdivisionLevel() const
@@ -203,93 +444,1383 @@ unsigned int Sphere::getSubdivisionLevel() const
 	return subdivisions;
 }
 
-void Sphere::sendBufferData()
+void Sphere::regenerate()
 {
-	glBindVertexArray(VAO);
+	auto startTime = std::chrono::steady_clock::now();
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER,
-		static_cast<GLsizeiptr>(sizeof(vertices[0]) * vertices.size()),
-		vertices.data(),
-		GL_STATIC_DRAW);
+	// The mesh is rebuilt right away, so it is dropped instead of being parked in the cache.
+	// Clearing keeps the storage for the rebuild
+	unsigned int level = subdivisions;
+	mappedFile.close();
+	vertices.clear();
+	indices.clear();
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		static_cast<GLsizeiptr>(sizeof(indices[0]) * indices.size()),
-		indices.data(),
-		GL_STATIC_DRAW);
+	generateBase();
+	buildLevel(level);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-	glEnableVertexAttribArray(0);
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
 }
 
-void Sphere::render(Shader& shader, int modelLocation)
+bool Sphere::generate(const MeshKey& key)
 {
-	glBindVertexArray(VAO);
+	auto startTime = std::chrono::steady_clock::now();
 
-	glm::mat4 model(1.0f);
-	model = glm::translate(model, position);
-	model = glm::rotate(model, rotationAngle, rotationAxis);
-	model = glm::scale(model, glm::vec3(radius, radius, radius));
+	if (vertices.empty() || !getMeshKey().sameShape(key) || key.level < subdivisions)
+	{
+		setShape(key);
+		generateBase();
+	}
 
-	glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+	buildLevel(key.level);
 
-	glDrawElements(GL_TRIANGLES,
-		static_cast<GLsizei>(indices.size()),
-		GL_UNSIGNED_INT,
-		nullptr);
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
 
-	glBindVertexArray(0);
+	return subdivisions == key.level;
 }
 
-void Sphere::setPosition(glm::vec3 position)
+bool Sphere::chooseForBudget(size_t maxTriangles, MeshEstimate& choice) const
 {
-	this->position = position;
+	if (!chooseMeshForBudget(maxTriangles, subdivisionMode, choice))
+		return false;
+
+	// Estimates are for the unit sphere
+	choice.error *= radius;
+	return true;
 }
 
-void Sphere::setRotationAxis(glm::vec3 axis)
+bool Sphere::chooseForError(double maxRadialError, MeshEstimate& choice) const
 {
-	rotationAxis = axis;
+	if (!chooseMeshForError(maxRadialError / radius, subdivisionMode, choice))
+		return false;
+
+	choice.error *= radius;
+	return true;
 }
 
-void Sphere::setRotationAngle(float angle)
+bool Sphere::generateForBudget(size_t maxTriangles)
 {
-	rotationAngle = angle;
+	MeshEstimate choice {};
+
+	if (!chooseForBudget(maxTriangles, choice))
+		return false;
+
+	buildChoice(choice.key);
+	return true;
 }
 
-void Sphere::setRadius(float radius)
+bool Sphere::generateForError(double maxRadialError)
 {
-	this->radius = radius;
+	MeshEstimate choice {};
+
+	if (!chooseForError(maxRadialError, choice))
+		return false;
+
+	buildChoice(choice.key);
+	return true;
 }
 
-float Sphere::getRadius() const
+void Sphere::buildChoice(const MeshKey& key)
 {
-	return radius;
+	if (!vertices.empty() && getMeshKey() == key)
+		return;
+
+	if (restoreCached(key))
+		return;
+
+	parkMesh();
+	generate(key);
 }
 
-SphereType Sphere::getType() const
+void Sphere::setProgressCallback(std::function<bool(float)> callback)
 {
-	return type;
+	progressCallback = std::move(callback);
 }
 
-size_t Sphere::getVertexCount() const
+void Sphere::adoptMesh(const MeshKey& key, std::vector<float>& newVertices, std::vector<unsigned int>& newIndices, double time)
 {
-	return vertices.size() / 3;
+	parkMesh();
+	resetMeshStorage();
+
+	vertices.assign(newVertices.begin(), newVertices.end());
+	indices.assign(newIndices.begin(), newIndices.end());
+
+	setShape(key);
+	generationTime = time;
+
+	buffersDirty = true;
+	meshletsDirty = true;
 }
 
-size_t Sphere::getTriangleCount() const
+void Sphere::releaseMesh(std::vector<float>& outVertices, std::vector<unsigned int>& outIndices)
 {
-	return indices.size() / 3;
+	outVertices.assign(vertices.begin(), vertices.end());
+	outIndices.assign(indices.begin(), indices.end());
+
+	resetMeshStorage();
+
+	buffersDirty = true;
 }
 
-unsigned int Sphere::getSectors() const
+bool Sphere::restoreCached(const MeshKey& key)
 {
-	return sectors;
+	if (!meshCache.contains(key))
+		return false;
+
+	parkMesh();
+	restoreMesh(key);
+	setShape(key);
+
+	return true;
 }
 
-unsigned int Sphere::getStacks() const
+void Sphere::setSubdivisionMode(SubdivisionMode mode)
 {
-	return stacks;
+	if (mode == subdivisionMode)
+		return;
+
+	// The current mesh is cached under its old mode
+	parkMesh();
+	subdivisionMode = mode;
+
+	unsigned int level = subdivisions;
+	generateBase();
+	subdivide(level);
+}
+
+SubdivisionMode Sphere::getSubdivisionMode() const
+{
+	return subdivisionMode;
+}
+
+void Sphere::setThreadCount(unsigned int threadCount)
+{
+	threadPool.setThreadCount(threadCount);
+}
+
+unsigned int Sphere::getThreadCount() const
+{
+	return threadPool.getThreadCount();
+}
+
+ThreadPool& Sphere::getThreadPool()
+{
+	return threadPool;
+}
+
+void Sphere::setTaskTiming(bool enabled)
+{
+	threadPool.setTimingEnabled(enabled);
+}
+
+bool Sphere::getTaskTiming() const
+{
+	return threadPool.getTimingEnabled();
+}
+
+std::vector<WorkerStats> Sphere::getWorkerStats() const
+{
+	return threadPool.getWorkerStats();
+}
+
+void Sphere::resetWorkerStats()
+{
+	threadPool.resetWorkerStats();
+}
+
+ArenaStats Sphere::getScratchStats() const
+{
+	return scratchArena.getStats();
+}
+
+ArenaStats Sphere::getMeshStats() const
+{
+	return meshArena.getStats();
+}
+
+void Sphere::setUploadMethod(UploadMethod method)
+{
+	uploader.setMethod(method);
+}
+
+UploadMethod Sphere::getUploadMethod() const
+{
+	return uploader.getMethod();
+}
+
+UploadStats Sphere::getUploadStats() const
+{
+	return uploader.getStats();
+}
+
+double Sphere::getGenerationTime() const
+{
+	return generationTime;
+}
+
+void Sphere::setCacheBudget(size_t bytes)
+{
+	meshCache.setBudget(bytes);
+}
+
+size_t Sphere::getCacheBudget() const
+{
+	return meshCache.getBudget();
+}
+
+size_t Sphere::getCacheUsedBytes() const
+{
+	return meshCache.getUsedBytes();
+}
+
+size_t Sphere::getCachedLevelCount() const
+{
+	return meshCache.getEntryCount();
+}
+
+bool Sphere::save(const std::string& path) const
+{
+	if (type == SphereType::AdaptiveIcoSphere)
+	{
+		std::cout << "Adaptive meshes depend on the camera and can't be saved\n";
+		return false;
+	}
+
+	if (type == SphereType::FibonacciSphere)
+	{
+		std::cout << "Point spheres have no triangles to save\n";
+		return false;
+	}
+
+	std::vector<uint16_t> narrowed(getIndexWidth() == sizeof(uint16_t) ? getTriangleCount() * 3 : 0);
+
+	return writeMeshFile(path, getMeshKey(),
+		getVertexData(), getVertexCount(),
+		getIndexData(narrowed), getTriangleCount() * 3, getIndexWidth());
+}
+
+bool Sphere::loadMapped(const std::string& path)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	MeshFile file;
+
+	if (!file.open(path))
+		return false;
+
+	parkMesh();
+	resetMeshStorage();
+
+	mappedFile = std::move(file);
+	setShape(mappedFile.getKey());
+
+	buffersDirty = true;
+
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+	return true;
+}
+
+bool Sphere::isMapped() const
+{
+	return mappedFile.isOpen();
+}
+
+void Sphere::setVertexFormat(VertexFormat format)
+{
+	if (format == vertexFormat)
+		return;
+
+	vertexFormat = format;
+	positionError = 0.0f;
+
+	buffersDirty = true;
+	meshCache.discardUploads();
+}
+
+VertexFormat Sphere::getVertexFormat() const
+{
+	return vertexFormat;
+}
+
+size_t Sphere::getVertexStride() const
+{
+	return vertexFormat == VertexFormat::Octahedral ? sizeof(OctahedralVertex) : sizeof(float) * 3;
+}
+
+float Sphere::getPositionError() const
+{
+	return positionError;
+}
+
+void Sphere::setVertexCacheOptimization(bool enabled)
+{
+	if (enabled == vertexCacheOptimization)
+		return;
+
+	vertexCacheOptimization = enabled;
+
+	// Optimize the current mesh on the next upload
+	if (enabled)
+		buffersDirty = true;
+}
+
+bool Sphere::getVertexCacheOptimization() const
+{
+	return vertexCacheOptimization;
+}
+
+VertexCacheStats Sphere::getCacheStatsBefore() const
+{
+	return cacheStatsBefore;
+}
+
+VertexCacheStats Sphere::getCacheStatsAfter() const
+{
+	return cacheStatsAfter;
+}
+
+double Sphere::getOptimizationTime() const
+{
+	return optimizationTime;
+}
+
+void Sphere::sendBufferData()
+{
+	std::vector<MeshBuffers>& freeBuffers = meshCache.getFreeBuffers();
+
+	if (buffersDirty && buffers.VAO == 0)
+	{
+		// Reuse the buffers of an evicted level if there is one
+		if (!freeBuffers.empty())
+		{
+			buffers = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+		else
+		{
+			init();
+		}
+	}
+
+	// Release the GPU memory of any other evicted levels
+	for (MeshBuffers& freeBuffer : freeBuffers)
+	{
+		glDeleteVertexArrays(1, &freeBuffer.VAO);
+		glDeleteBuffers(1, &freeBuffer.VBO);
+		glDeleteBuffers(1, &freeBuffer.EBO);
+	}
+
+	freeBuffers.clear();
+
+	if (!buffersDirty)
+	{
+		updateMeshlets();
+		return;
+	}
+
+	// A mapped mesh is uploaded as it was saved, and reordering the adaptive mesh
+	// would break the vertex indices its refiner keeps between frames
+	if (vertexCacheOptimization && !mappedFile.isOpen() && type != SphereType::AdaptiveIcoSphere && getTriangleCount() > 0)
+		optimizeMesh();
+
+	const void* vertexData = getVertexData();
+	const void* indexData = nullptr;
+
+	// Upload copies only live until the upload, and the arena isn't thread safe,
+	// so both are taken before the tasks start
+	scratchArena.reset();
+
+	std::span<OctahedralVertex> packedVertices {};
+	std::span<uint16_t> shortIndices {};
+
+	if (vertexFormat == VertexFormat::Octahedral)
+		packedVertices = scratchArena.allocate<OctahedralVertex>(getVertexCount());
+
+	if (getIndexWidth() == sizeof(uint16_t))
+		shortIndices = scratchArena.allocate<uint16_t>(getTriangleCount() * 3);
+
+	// Encoding the vertices and narrowing the indices don't depend on each other
+	TaskGroup uploadTasks(threadPool);
+
+	auto encode = [&] { encodePositions(packedVertices); };
+	auto narrow = [&] { indexData = getIndexData(shortIndices); };
+
+	if (vertexFormat == VertexFormat::Octahedral)
+		uploadTasks.run(encode);
+
+	uploadTasks.run(narrow);
+	uploadTasks.wait();
+
+	if (vertexFormat == VertexFormat::Octahedral)
+		vertexData = packedVertices.data();
+
+	const size_t vertexBytes = getVertexStride() * getVertexCount();
+	const size_t indexBytes = getIndexWidth() * 3 * getTriangleCount();
+
+	// The element buffer binding belongs to the vertex array
+	glBindVertexArray(buffers.VAO);
+
+	uploader.begin(vertexBytes + indexBytes);
+	uploader.upload(threadPool, GL_ELEMENT_ARRAY_BUFFER, buffers.EBO, buffers.indexCapacity, indexData, indexBytes);
+	uploader.upload(threadPool, GL_ARRAY_BUFFER, buffers.VBO, buffers.vertexCapacity, vertexData, vertexBytes);
+	uploader.end();
+
+	// Octahedral coordinates arrive as unnormalized integers and are scaled in the shader
+	if (vertexFormat == VertexFormat::Octahedral)
+		glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(OctahedralVertex), nullptr);
+	else
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+
+	glEnableVertexAttribArray(0);
+
+	buffersDirty = false;
+	meshletsDirty = true;
+
+	updateMeshlets();
+}
+
+bool Sphere::updateAdaptive(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition, float viewportHeight)
+{
+	if (type != SphereType::AdaptiveIcoSphere)
+		return false;
+
+	// Refinement happens on the unit sphere, and the error to distance ratio doesn't change with radius
+	glm::mat4 model = getModelMatrix();
+
+	AdaptiveView newView {};
+	newView.modelViewProjection = projection * view * model;
+	newView.cameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+	newView.projectionScale = projection[1][1] * viewportHeight * 0.5f;
+
+	if (!adaptiveDirty &&
+		newView.modelViewProjection == adaptiveView.modelViewProjection &&
+		newView.cameraPosition == adaptiveView.cameraPosition &&
+		newView.projectionScale == adaptiveView.projectionScale)
+		return false;
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	adaptiveView = newView;
+	adaptiveRefiner.refine(adaptiveView, vertices, indices);
+
+	auto endTime = std::chrono::steady_clock::now();
+	generationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+	adaptiveDirty = false;
+	buffersDirty = true;
+
+	return true;
+}
+
+void Sphere::setAdaptiveErrorThreshold(float pixels)
+{
+	adaptiveRefiner.setErrorThreshold(pixels);
+	adaptiveDirty = true;
+}
+
+float Sphere::getAdaptiveErrorThreshold() const
+{
+	return adaptiveRefiner.getErrorThreshold();
+}
+
+void Sphere::setClusterCulling(bool enabled)
+{
+	clusterCulling = enabled;
+	updateMeshlets();
+}
+
+bool Sphere::getClusterCulling() const
+{
+	return clusterCulling;
+}
+
+void Sphere::cullClusters(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition)
+{
+	culledFraction = 0.0f;
+
+	if (!clusterCulling || meshletsDirty || meshlets.empty())
+		return;
+
+	// Culling happens in model space, where the meshlet bounds are
+	glm::mat4 model = getModelMatrix();
+	glm::vec3 modelCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+	size_t visibleTriangles = meshlets.cull(threadPool, projection * view * model, modelCamera,
+		getIndexWidth(), drawCounts, drawOffsets);
+
+	culledFraction = 1.0f - static_cast<float>(visibleTriangles) / static_cast<float>(getTriangleCount());
+}
+
+float Sphere::getCulledFraction() const
+{
+	return culledFraction;
+}
+
+size_t Sphere::getMeshletCount() const
+{
+	return meshlets.size();
+}
+
+void Sphere::render(Shader& shader, int modelLocation)
+{
+	if (buffers.VAO == 0)
+		return;
+
+	glBindVertexArray(buffers.VAO);
+
+	glm::mat4 model = getModelMatrix();
+
+	glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+	shader.setBool("octahedralPositions", vertexFormat == VertexFormat::Octahedral);
+
+	const GLenum indexType = getIndexWidth() == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	// Points are drawn straight from the vertex buffer
+	if (type == SphereType::FibonacciSphere)
+	{
+		glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(getVertexCount()));
+	}
+	// Only the visible meshlet runs from the last cullClusters call
+	else if (clusterCulling && !meshletsDirty && !meshlets.empty())
+	{
+		glMultiDrawElements(GL_TRIANGLES,
+			drawCounts.data(),
+			indexType,
+			drawOffsets.data(),
+			static_cast<GLsizei>(drawCounts.size()));
+	}
+	else
+	{
+		glDrawElements(GL_TRIANGLES,
+			static_cast<GLsizei>(getTriangleCount() * 3),
+			indexType,
+			nullptr);
+	}
+
+	glBindVertexArray(0);
+}
+
+void Sphere::renderInstances(Shader& shader, unsigned int instanceBuffer, size_t firstInstance, size_t instanceCount)
+{
+	if (buffers.VAO == 0 || instanceCount == 0)
+		return;
+
+	glBindVertexArray(buffers.VAO);
+
+	// Center and radius make one vec4, the rotation the other. Both advance once per instance
+	const size_t offset = firstInstance * sizeof(SphereInstance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance),
+		reinterpret_cast<const void*>(offset + offsetof(SphereInstance, center)));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance),
+		reinterpret_cast<const void*>(offset + offsetof(SphereInstance, rotation)));
+
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	shader.setBool("octahedralPositions", vertexFormat == VertexFormat::Octahedral);
+
+	const GLenum indexType = getIndexWidth() == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	// Meshlet culling works in the space of one model matrix, so every instance draws the whole mesh
+	if (type == SphereType::FibonacciSphere)
+	{
+		glDrawArraysInstanced(GL_POINTS, 0, static_cast<GLsizei>(getVertexCount()), static_cast<GLsizei>(instanceCount));
+	}
+	else
+	{
+		glDrawElementsInstanced(GL_TRIANGLES,
+			static_cast<GLsizei>(getTriangleCount() * 3),
+			indexType,
+			nullptr,
+			static_cast<GLsizei>(instanceCount));
+	}
+
+	// The single-sphere draw leaves them off
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+}
+
+void Sphere::setPosition(glm::vec3 position)
+{
+	this->position = position;
+}
+
+void Sphere::setRotationAxis(glm::vec3 axis)
+{
+	rotationAxis = axis;
+}
+
+void Sphere::setRotationAngle(float angle)
+{
+	rotationAngle = angle;
+}
+
+void Sphere::setRadius(float radius)
+{
+	this->radius = radius;
+}
+
+float Sphere::getRadius() const
+{
+	return radius;
+}
+
+SphereType Sphere::getType() const
+{
+	return type;
+}
+
+size_t Sphere::getVertexCount() const
+{
+	if (mappedFile.isOpen())
+		return mappedFile.getVertexCount();
+
+	return vertices.size() / 3;
+}
+
+size_t Sphere::getIndexWidth() const
+{
+	return ::getIndexWidth(getVertexCount());
+}
+
+size_t Sphere::getTriangleCount() const
+{
+	if (mappedFile.isOpen())
+		return mappedFile.getIndexCount() / 3;
+
+	return indices.size() / 3;
+}
+
+unsigned int Sphere::getSectors() const
+{
+	return sectors;
+}
+
+unsigned int Sphere::getStacks() const
+{
+	return stacks;
+}
+
+unsigned int Sphere::getCubeResolution() const
+{
+	return cubeResolution;
+}
+
+bool Sphere::getCubeWarp() const
+{
+	return cubeWarp;
+}
+
+unsigned int Sphere::getOctaResolution() const
+{
+	return octaResolution;
+}
+
+double Sphere::measureSurfaceError()
+{
+	if (type == SphereType::FibonacciSphere)
+		return 0.0;
+
+	// Needs the vertices as floats and the indices at full width
+	if (mappedFile.isOpen())
+		copyMapping();
+
+	return getMaxSphereError(threadPool, vertices.data(), indices.data(), getTriangleCount());
+}
+
+void Sphere::generateBase()
+{
+	if (type == SphereType::IcoSphere)
+		generateIcosphere();
+	else if (type == SphereType::CubeSphere)
+		generateCubesphere(cubeResolution, cubeWarp);
+	else if (type == SphereType::SectorSphere)
+		generateSectorsphere(sectors, stacks);
+	else if (type == SphereType::AdaptiveIcoSphere)
+		generateAdaptiveIcosphere();
+	else if (type == SphereType::FibonacciSphere)
+		generateFibonacciSphere(fibonacciPoints);
+	else if (type == SphereType::HEALPix)
+		generateHealpixSphere();
+	else if (type == SphereType::OctaSphere)
+		generateOctasphere(octaResolution);
+}
+
+void Sphere::buildLevel(unsigned int level)
+{
+	// Every level is built in memory, so a mapped mesh must not shadow it
+	mappedFile.close();
+
+	// Refined on the next updateAdaptive call instead
+	if (type == SphereType::AdaptiveIcoSphere)
+	{
+		adaptiveRefiner.setMaxLevel(level);
+		subdivisions = level;
+		adaptiveDirty = true;
+		return;
+	}
+
+	// HEALPix and octahedron grids have a closed form at every level, so they are built in one pass like Direct mode
+	if (type == SphereType::HEALPix || type == SphereType::OctaSphere)
+	{
+		// The base shape at level 0 is already the finished mesh
+		if (level == subdivisions && !vertices.empty())
+			return;
+
+		if (progressCallback && !progressCallback(0.0f))
+			return;
+
+		if (type == SphereType::HEALPix)
+		{
+			subdivisions = std::min(level, healpixMaxOrder);
+			buildHealpix(subdivisions);
+		}
+		else
+		{
+			subdivisions = level;
+			buildOctasphere(octaResolution << level);
+		}
+
+		buffersDirty = true;
+		return;
+	}
+
+	if (level < subdivisions)
+		generateBase();
+
+	// Low icosphere levels are baked into the binary in the shared vertex layout,
+	// so start from the deepest one at or below the target
+	if (type == SphereType::IcoSphere && subdivisionMode == SubdivisionMode::SharedVertices)
+	{
+		unsigned int bakedLevel = std::min(level, bakedIcosphereLevels - 1);
+
+		if (bakedLevel > subdivisions)
+			loadBakedIcosphere(bakedLevel);
+	}
+
+	if (subdivisionMode == SubdivisionMode::Direct)
+	{
+		if (subdivisions != 0)
+			generateBase();
+
+		// Built in one pass, so it can only be cancelled before it starts
+		if (progressCallback && !progressCallback(0.0f))
+			return;
+
+		subdivideDirect(level);
+	}
+	else
+	{
+		// Each pass costs about four times the one before it, which weights the progress
+		const float totalWork = std::pow(4.0f, static_cast<float>(level)) - std::pow(4.0f, static_cast<float>(subdivisions));
+		const unsigned int firstLevel = subdivisions;
+
+		for (unsigned int i = firstLevel; i < level; i++)
+		{
+			if (progressCallback)
+			{
+				float doneWork = std::pow(4.0f, static_cast<float>(i)) - std::pow(4.0f, static_cast<float>(firstLevel));
+
+				// Stop at the last finished level, a later build can continue from it
+				if (!progressCallback(doneWork / totalWork))
+				{
+					subdivisions = i;
+					buffersDirty = true;
+					return;
+				}
+			}
+
+			if (subdivisionMode == SubdivisionMode::SharedVertices)
+				subdivideShared();
+			else
+				subdivideDuplicated();
+		}
+	}
+
+	subdivisions = level;
+	buffersDirty = true;
+}
+
+void Sphere::loadBakedIcosphere(unsigned int level)
+{
+	BakedIcosphere baked = getBakedIcosphere(level);
+
+	vertices.assign(baked.vertices, baked.vertices + baked.vertexCount * 3);
+	indices.assign(baked.indices, baked.indices + baked.triangleCount * 3);
+
+	subdivisions = level;
+}
+
+void Sphere::buildHealpix(unsigned int order)
+{
+	vertices.resize(getHealpixVertexCount(order) * 3);
+	indices.resize(getHealpixPixelCount(order) * 6);
+
+	generateHealpixGrid(threadPool, order, vertices.data(), indices.data());
+}
+
+void Sphere::buildOctasphere(unsigned int segments)
+{
+	vertices.resize(getOctaSphereVertexCount(segments) * 3);
+	indices.resize(getOctaSphereTriangleCount(segments) * 3);
+
+	generateOctaSphere(threadPool, segments, vertices.data(), indices.data());
+}
+
+void Sphere::copyMapping()
+{
+	vertices.assign(mappedFile.getVertices(), mappedFile.getVertices() + mappedFile.getVertexCount() * 3);
+
+	if (mappedFile.getIndexWidth() == sizeof(uint16_t))
+	{
+		const uint16_t* shortData = static_cast<const uint16_t*>(mappedFile.getIndices());
+		indices.assign(shortData, shortData + mappedFile.getIndexCount());
+	}
+	else
+	{
+		const unsigned int* data = static_cast<const unsigned int*>(mappedFile.getIndices());
+		indices.assign(data, data + mappedFile.getIndexCount());
+	}
+
+	mappedFile.close();
+}
+
+const float* Sphere::getVertexData() const
+{
+	return mappedFile.isOpen() ? mappedFile.getVertices() : vertices.data();
+}
+
+glm::mat4 Sphere::getModelMatrix() const
+{
+	glm::mat4 model(1.0f);
+	model = glm::translate(model, position);
+	model = glm::rotate(model, rotationAngle, rotationAxis);
+	model = glm::scale(model, glm::vec3(radius, radius, radius));
+
+	return model;
+}
+
+void Sphere::updateMeshlets()
+{
+	if (!clusterCulling || !meshletsDirty)
+		return;
+
+	// Mapped meshes are drawn whole
+	if (mappedFile.isOpen())
+		meshlets.clear();
+	else
+		meshlets.build(threadPool, vertices.data(), indices.data(), getVertexCount(), getTriangleCount());
+
+	drawCounts.clear();
+	drawOffsets.clear();
+
+	meshletsDirty = false;
+}
+
+void Sphere::optimizeMesh()
+{
+	// Subdivision keeps the triangles of each base face together, so partitions follow the
+	// 20 icosahedron faces, the 6 cube faces, the 8 octahedron faces or the 12 HEALPix base pixels.
+	// Sector spheres are split by thread count
+	size_t partitionCount = threadPool.getThreadCount() * 4;
+
+	if (type == SphereType::IcoSphere)
+		partitionCount = 20;
+	else if (type == SphereType::CubeSphere)
+		partitionCount = 6;
+	else if (type == SphereType::HEALPix)
+		partitionCount = 12;
+	else if (type == SphereType::OctaSphere)
+		partitionCount = 8;
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	cacheStatsBefore = meshOptimizer.measure(threadPool, indices, getVertexCount(), partitionCount);
+	meshOptimizer.optimize(threadPool, indices, vertices, partitionCount);
+	cacheStatsAfter = meshOptimizer.measure(threadPool, indices, getVertexCount(), partitionCount);
+
+	auto endTime = std::chrono::steady_clock::now();
+	optimizationTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void Sphere::encodePositions(std::span<OctahedralVertex> packed)
+{
+	const float* source = getVertexData();
+	const size_t count = getVertexCount();
+
+	// Error is non-negative, so its bits order the same way as its value
+	std::atomic<uint32_t> maxErrorBits {0};
+
+	threadPool.parallelFor(count, [&](size_t begin, size_t end)
+	{
+		float maxError = 0.0f;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 vertex {source[i * 3], source[i * 3 + 1], source[i * 3 + 2]};
+
+			packed[i] = encodeOctahedral(vertex);
+			maxError = std::max(maxError, glm::length(decodeOctahedral(packed[i]) - vertex));
+		}
+
+		atomicMax(maxErrorBits, std::bit_cast<uint32_t>(maxError));
+	});
+
+	positionError = std::bit_cast<float>(maxErrorBits.load());
+}
+
+const void* Sphere::getIndexData(std::span<uint16_t> narrowed) const
+{
+	if (mappedFile.isOpen() && mappedFile.getIndexWidth() == getIndexWidth())
+		return mappedFile.getIndices();
+
+	// Anything else holds 32-bit indices
+	const unsigned int* data = mappedFile.isOpen() ? static_cast<const unsigned int*>(mappedFile.getIndices()) : indices.data();
+
+	if (getIndexWidth() == sizeof(unsigned int))
+		return data;
+
+	const size_t count = getTriangleCount() * 3;
+
+	for (size_t i = 0; i < count; i++)
+		narrowed[i] = static_cast<uint16_t>(data[i]);
+
+	return narrowed.data();
+}
+
+void Sphere::setShape(const MeshKey& key)
+{
+	type = key.type;
+	subdivisionMode = key.mode;
+	subdivisions = key.level;
+
+	if (type == SphereType::SectorSphere)
+	{
+		sectors = key.sectors;
+		stacks = key.stacks;
+	}
+	else if (type == SphereType::CubeSphere)
+	{
+		cubeResolution = key.resolution;
+		cubeWarp = key.warp;
+	}
+	else if (type == SphereType::OctaSphere)
+	{
+		octaResolution = key.resolution;
+	}
+}
+
+MeshKey Sphere::getMeshKey() const
+{
+	MeshKey key {};
+	key.type = type;
+	key.mode = subdivisionMode;
+	key.level = subdivisions;
+
+	if (type == SphereType::SectorSphere)
+	{
+		key.sectors = sectors;
+		key.stacks = stacks;
+	}
+	else if (type == SphereType::CubeSphere)
+	{
+		key.resolution = cubeResolution;
+		key.warp = cubeWarp;
+	}
+	else if (type == SphereType::OctaSphere)
+	{
+		key.resolution = octaResolution;
+	}
+
+	return key;
+}
+
+void Sphere::parkMesh()
+{
+	// The adaptive mesh only fits the view it was refined for, and point spheres
+	// are a single pass over the points with no level to key them by
+	if (type == SphereType::AdaptiveIcoSphere || type == SphereType::FibonacciSphere)
+		return;
+
+	// A mapped mesh can be mapped again from its file, so it isn't cached
+	if (mappedFile.isOpen())
+	{
+		mappedFile.close();
+
+		if (buffers.VAO != 0)
+			meshCache.getFreeBuffers().push_back(buffers);
+
+		buffers = {};
+		buffersDirty = true;
+		return;
+	}
+
+	if (meshCache.getBudget() == 0 || vertices.empty())
+		return;
+
+	// Reused buffers can hold more storage than this mesh needs
+	size_t gpuBytes = buffers.vertexCapacity + buffers.indexCapacity;
+	meshCache.store(getMeshKey(), vertices, indices, buffers, buffersDirty ? 0 : gpuBytes);
+
+	vertices.clear();
+	indices.clear();
+
+	buffers = {};
+	buffersDirty = true;
+}
+
+void Sphere::resetMeshStorage()
+{
+	// The allocator never frees, so every vector lets go of its storage before the reset
+	vertices = ArenaVector<float>(meshArena);
+	indices = ArenaVector<unsigned int>(meshArena);
+	backVertices = ArenaVector<float>(meshArena);
+	backIndices = ArenaVector<unsigned int>(meshArena);
+
+	meshArena.reset();
+}
+
+bool Sphere::restoreMesh(const MeshKey& key)
+{
+	bool uploaded = false;
+
+	if (!meshCache.take(key, vertices, indices, buffers, uploaded))
+		return false;
+
+	subdivisions = key.level;
+	buffersDirty = !uploaded;
+	meshletsDirty = true;
+
+	return true;
+}
+
+void Sphere::subdivideDuplicated()
+{
+	// The current level moves to the back buffers and the new level is written over
+	// the front ones, so no copy is made and both keep their capacity between levels
+	vertices.swap(backVertices);
+	indices.swap(backIndices);
+
+	const ArenaVector<float>& oldVertices = backVertices;
+	const ArenaVector<unsigned int>& oldIndices = backIndices;
+
+	// Every triangle turns into 6 vertices and 4 triangles, so the prefix sum of the
+	// output sizes puts triangle t at vertex t * 6 and index t * 12
+	const size_t numTriangles = oldIndices.size() / 3;
+
+	vertices.resize(numTriangles * 6 * 3);
+	indices.resize(numTriangles * 12);
+
+	threadPool.parallelFor(numTriangles, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; j++)
+		{
+			size_t v1Pos = oldIndices[j * 3] * 3;
+			size_t v2Pos = oldIndices[j * 3 + 1] * 3;
+			size_t v3Pos = oldIndices[j * 3 + 2] * 3;
+
+			glm::vec3 v1 {oldVertices[v1Pos], oldVertices[v1Pos + 1], oldVertices[v1Pos + 2]};
+			glm::vec3 v2 {oldVertices[v2Pos], oldVertices[v2Pos + 1], oldVertices[v2Pos + 2]};
+			glm::vec3 v3 {oldVertices[v3Pos], oldVertices[v3Pos + 1], oldVertices[v3Pos + 2]};
+
+			unsigned int index = static_cast<unsigned int>(j * 6);
+
+			writeTriangleMidpoints(&vertices[index * 3], v1, v2, v3); // 0, 1, 2
+			setVertex(index + 3, v1);     // 3
+			setVertex(index + 4, v2);     // 4
+			setVertex(index + 5, v3);     // 5
+
+			// Children keep the winding of their parent
+			setIndices(j * 4, index, index + 1, index + 2);
+			setIndices(j * 4 + 1, index + 2, index + 1, index + 5);
+			setIndices(j * 4 + 2, index + 1, index, index + 4);
+			setIndices(j * 4 + 3, index, index + 2, index + 3);
+		}
+	});
+}
+
+void Sphere::subdivideShared()
+{
+	// Existing vertices stay where they are, only the index buffers ping-pong
+	indices.swap(backIndices);
+
+	const ArenaVector<unsigned int>& oldIndices = backIndices;
+
+	// A closed triangle mesh has 3/2 edges per triangle, and each edge adds one vertex
+	const size_t numTriangles = oldIndices.size() / 3;
+	const size_t numEdges = numTriangles * 3 / 2;
+
+	midpointCache.reset(numEdges);
+
+	// Seams of the sector sphere are open, so every edge of every triangle is the safe bound
+	scratchArena.reset();
+	midpointEdges = scratchArena.allocate<unsigned int>(numTriangles * 3 * 2);
+	midpointCount = 0;
+
+	vertices.reserve(vertices.size() + numEdges * 3);
+	indices.resize(oldIndices.size() * 4);
+
+	// Midpoint indices are handed out serially so the vertex order never depends on the thread count.
+	// The existing vertices keep their indices, new midpoints are appended after them
+	for (size_t j = 0; j < numTriangles; j++)
+	{
+		unsigned int v1 = oldIndices[j * 3];
+		unsigned int v2 = oldIndices[j * 3 + 1];
+		unsigned int v3 = oldIndices[j * 3 + 2];
+
+		unsigned int mid1 = addMidpoint(v1, v2);
+		unsigned int mid2 = addMidpoint(v2, v3);
+		unsigned int mid3 = addMidpoint(v3, v1);
+
+		setIndices(j * 4, v1, mid1, mid3);
+		setIndices(j * 4 + 1, mid1, v2, mid2);
+		setIndices(j * 4 + 2, mid3, mid2, v3);
+		setIndices(j * 4 + 3, mid1, mid2, mid3);
+	}
+
+	const size_t firstMidpoint = getVertexCount();
+	const size_t numMidpoints = midpointCount;
+
+	vertices.resize((firstMidpoint + numMidpoints) * 3);
+
+	threadPool.parallelFor(numMidpoints, [&](size_t begin, size_t end)
+	{
+		MidpointBatch batch(vertices.data());
+
+		for (size_t k = begin; k < end; k++)
+			batch.add(firstMidpoint + k, getVertex(midpointEdges[k * 2]), getVertex(midpointEdges[k * 2 + 1]));
+	});
+}
+
+void Sphere::subdivideDirect(unsigned int level)
+{
+	// Each base triangle becomes a triangular lattice with n segments per edge,
+	// which is the same grid that `level` rounds of midpoint subdivision produce
+	const unsigned int n = 1u << level;
+
+	const size_t numBaseVertices = getVertexCount();
+	const size_t numFaces = indices.size() / 3;
+
+	// Number every edge of the base mesh once, and remember which edges belong to each face
+	scratchArena.reset();
+	std::span<unsigned int> faceEdges = scratchArena.allocate<unsigned int>(numFaces * 3);
+
+	midpointCache.reset(numFaces * 3 / 2);
+	midpointEdges = scratchArena.allocate<unsigned int>(numFaces * 3 * 2);
+	midpointCount = 0;
+
+	for (size_t face = 0; face < numFaces; face++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = indices[face * 3 + k];
+			unsigned int b = indices[face * 3 + (k + 1) % 3];
+
+			auto [edge, inserted] = midpointCache.insert(a, b, static_cast<unsigned int>(midpointCount));
+
+			if (inserted)
+			{
+				midpointEdges[midpointCount * 2] = std::min(a, b);
+				midpointEdges[midpointCount * 2 + 1] = std::max(a, b);
+				midpointCount++;
+			}
+
+			faceEdges[face * 3 + k] = edge;
+		}
+	}
+
+	const std::span<const unsigned int> edges = midpointEdges.first(midpointCount * 2);
+
+	const size_t numEdges = midpointCount;
+	const size_t pointsPerEdge = n - 1;
+	const size_t pointsPerFace = static_cast<size_t>(n - 1) * (n - 2) / 2;
+
+	const size_t edgeStart = numBaseVertices;
+	const size_t faceStart = edgeStart + numEdges * pointsPerEdge;
+	const size_t numVertices = faceStart + numFaces * pointsPerFace;
+
+	indices.swap(backIndices);
+
+	const ArenaVector<unsigned int>& baseIndices = backIndices;
+
+	vertices.resize(numVertices * 3);
+	indices.resize(numFaces * n * n * 3);
+
+	// Fill each edge from the coarsest midpoint down, so every point is the midpoint of
+	// the same two points the iterative subdivision would have used
+	threadPool.parallelFor(numEdges, [&](size_t begin, size_t end)
+	{
+		MidpointBatch batch(vertices.data());
+
+		for (size_t edge = begin; edge < end; edge++)
+		{
+			auto edgeIndex = [&](unsigned int k) -> unsigned int
+			{
+				if (k == 0)
+					return edges[edge * 2];
+				if (k == n)
+					return edges[edge * 2 + 1];
+
+				return static_cast<unsigned int>(edgeStart + edge * pointsPerEdge + k - 1);
+			};
+
+			// Each stride reads the points written by the previous one, so the batch is flushed in between
+			for (unsigned int stride = n / 2; stride > 0; stride /= 2)
+			{
+				for (unsigned int k = stride; k < n; k += stride * 2)
+					batch.add(edgeIndex(k), getVertex(edgeIndex(k - stride)), getVertex(edgeIndex(k + stride)));
+
+				batch.flush();
+			}
+		}
+	});
+
+	// Faces only write their own interior vertices and their own n * n triangles,
+	// so they can be built independently once the edges are done
+	threadPool.parallelFor(numFaces, [&](size_t begin, size_t end)
+	{
+		MidpointBatch batch(vertices.data());
+
+		for (size_t face = begin; face < end; face++)
+		{
+			const unsigned int* corners = &baseIndices[face * 3];
+			const size_t interiorStart = faceStart + face * pointsPerFace;
+
+			// Returns the vertex index of point k along face edge `slot`, counted from corner `from` towards corner `to`
+			auto edgePoint = [&](int slot, int from, int to, unsigned int k) -> unsigned int
+			{
+				if (k == 0)
+					return corners[from];
+				if (k == n)
+					return corners[to];
+
+				unsigned int edge = faceEdges[face * 3 + slot];
+
+				// Edge points are stored from the lower to the higher vertex index
+				if (corners[from] != edges[edge * 2])
+					k = n - k;
+
+				return static_cast<unsigned int>(edgeStart + edge * pointsPerEdge + k - 1);
+			};
+
+			// Lattice point (i, j) sits i steps from corner 0 towards corner 1
+			// and j steps from corner 0 towards corner 2
+			auto latticeIndex = [&](unsigned int i, unsigned int j) -> unsigned int
+			{
+				if (j == 0)
+					return edgePoint(0, 0, 1, i);
+				if (i == 0)
+					return edgePoint(2, 0, 2, j);
+				if (i + j == n)
+					return edgePoint(1, 1, 2, j);
+
+				// Interior rows of constant j hold n - 1 - j points
+				size_t row = static_cast<size_t>(j - 1) * (n - 1) - static_cast<size_t>(j - 1) * j / 2;
+				return static_cast<unsigned int>(interiorStart + row + i - 1);
+			};
+
+			// Interior points are filled coarse to fine, using the lattice direction
+			// of the coarser edge they split
+			for (unsigned int stride = n / 2; stride > 0; stride /= 2)
+			{
+				for (unsigned int j = stride; j < n; j += stride)
+				{
+					for (unsigned int i = stride; i + j < n; i += stride)
+					{
+						bool oddI = (i / stride) % 2 == 1;
+						bool oddJ = (j / stride) % 2 == 1;
+
+						if (!oddI && !oddJ)
+							continue;
+
+						glm::vec3 a {};
+						glm::vec3 b {};
+
+						if (oddI && oddJ)
+						{
+							a = getVertex(latticeIndex(i + stride, j - stride));
+							b = getVertex(latticeIndex(i - stride, j + stride));
+						}
+						else if (oddI)
+						{
+							a = getVertex(latticeIndex(i - stride, j));
+							b = getVertex(latticeIndex(i + stride, j));
+						}
+						else
+						{
+							a = getVertex(latticeIndex(i, j - stride));
+							b = getVertex(latticeIndex(i, j + stride));
+						}
+
+						batch.add(latticeIndex(i, j), a, b);
+					}
+				}
+
+				batch.flush();
+			}
+
+			size_t triangle = face * n * n;
+
+			for (unsigned int j = 0; j < n; j++)
+			{
+				for (unsigned int i = 0; i + j < n; i++)
+				{
+					setIndices(triangle++, latticeIndex(i, j), latticeIndex(i + 1, j), latticeIndex(i, j + 1));
+
+					if (i + j + 1 < n)
+						setIndices(triangle++, latticeIndex(i + 1, j), latticeIndex(i + 1, j + 1), latticeIndex(i, j + 1));
+				}
+			}
+		}
+	});
+}
+
+unsigned int Sphere::addMidpoint(unsigned int a, unsigned int b)
+{
+	unsigned int newIndex = static_cast<unsigned int>(getVertexCount() + midpointCount);
+	auto [index, inserted] = midpointCache.insert(a, b, newIndex);
+
+	if (inserted)
+	{
+		midpointEdges[midpointCount * 2] = a;
+		midpointEdges[midpointCount * 2 + 1] = b;
+		midpointCount++;
+	}
+
+	return index;
+}
+
+glm::vec3 Sphere::getVertex(size_t index) const
+{
+	size_t position = index * 3;
+	return {vertices[position], vertices[position + 1], vertices[position + 2]};
+}
+
+void Sphere::setVertex(size_t index, glm::vec3 vertex)
+{
+	size_t position = index * 3;
+
+	vertices[position] = vertex.x;
+	vertices[position + 1] = vertex.y;
+	vertices[position + 2] = vertex.z;
+}
+
+void Sphere::setIndices(size_t triangle, unsigned int a, unsigned int b, unsigned int c)
+{
+	size_t position = triangle * 3;
+
+	indices[position] = a;
+	indices[position + 1] = b;
+	indices[position + 2] = c;
 }
 
 glm::vec3 Sphere::findMidpoint(const glm::vec3& a, const glm::vec3& b)
@@ -2,13 +2,65 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <string>
+#include <functional>
+#include <span>
 #include "shader.h"
+#include "midpoint_cache.h"
+#include "thread_pool.h"
+#include "mesh_cache.h"
+#include "mesh_file.h"
+#include "octahedral.h"
+#include "mesh_optimizer.h"
+#include "meshlets.h"
+#include "adaptive_refiner.h"
+#include "arena.h"
+#include "fibonacci_sphere.h"
+#include "healpix.h"
+#include "octa_sphere.h"
+#include "mesh_budget.h"
+#include "buffer_upload.h"
 
 enum class SphereType
 {
     IcoSphere,
     CubeSphere,
-    SectorSphere
+    SectorSphere,
+    // Icosphere refined per frame where the camera sees the most error
+    AdaptiveIcoSphere,
+    // Unconnected points on a spherical Fibonacci lattice, drawn without indices
+    FibonacciSphere,
+    // Equal-area HEALPix pixels of two triangles each, nside = 2^level
+    HEALPix,
+    // Octahedron with resolution * 2^level segments per edge, built from closed-form indices
+    OctaSphere
+};
+
+enum class SubdivisionMode
+{
+    // Every triangle gets its own six vertices
+    Duplicated,
+    // Edge midpoints are shared between neighbouring triangles
+    SharedVertices,
+    // Shared vertices, built straight at the target level from a lattice on each base face
+    Direct
+};
+
+enum class VertexFormat
+{
+    // Three 32-bit floats per vertex
+    Float3,
+    // Two 16-bit octahedral coordinates per vertex, decoded in the vertex shader
+    Octahedral
+};
+
+// Placement of one copy of a mesh in an instanced draw, read by the vertex shader
+struct SphereInstance
+{
+    glm::vec3 center {};
+    float radius = 1.0f;
+    // Unit quaternion as (x, y, z, w)
+    glm::vec4 rotation {0.0f, 0.0f, 0.0f, 1.0f};
 };
 
 class Sphere
@@ -19,16 +71,145 @@ public:
     void init();
 
     void generateIcosphere();
-    void generateCubesphere();
+    // Builds each cube face as a shared-vertex grid with `resolution` quads per side,
+    // giving 6 * resolution^2 + 2 vertices. `warp` spaces the grid by equal angles
+    void generateCubesphere(unsigned int resolution = 1, bool warp = false);
     void generateSectorsphere(unsigned int sectors, unsigned int stacks);
+    // Starts a view-dependent icosphere, refined by updateAdaptive up to the subdivision level
+    void generateAdaptiveIcosphere();
+    // Exactly `pointCount` points and no triangles, which subdivision leaves alone
+    void generateFibonacciSphere(size_t pointCount);
+    // Corner grid of the HEALPix pixels, `nside` is rounded down to a power of two
+    void generateHealpixSphere(unsigned int nside = 1);
+    void generateOctasphere(unsigned int resolution = 1);
+
+    size_t getFibonacciPointCount() const;
+    // Index of the Fibonacci point closest to the direction of `position` from the sphere center
+    size_t findNearestPoint(glm::vec3 position) const;
+
+    unsigned int getHealpixNside() const;
+    // Nested index of the HEALPix pixel in the direction of `position` from the sphere center
+    uint32_t findPixel(glm::vec3 position) const;
 
     void subdivide(unsigned int subdivisions);
     unsigned int getSubdivisionLevel() const;
 
-    // Sends data to GPU
+    // Rebuilds the current level from the base shape. The level cache is neither read nor filled
+    void regenerate();
+
+    // Builds the mesh described by `key`, continuing from the current mesh when it has the same
+    // shape at a lower level. Returns false if the progress callback cancelled it
+    bool generate(const MeshKey& key);
+
+    // Picks the most accurate mesh of any type with at most `maxTriangles` triangles in the current
+    // subdivision mode, from predicted counts and error without building anything.
+    // `choice.error` is in the units of the radius. Returns false if nothing fits
+    bool chooseForBudget(size_t maxTriangles, MeshEstimate& choice) const;
+    // Picks the mesh with the fewest triangles that stays within `maxRadialError` of the sphere,
+    // in the units of the radius. Returns false if no mesh gets that close
+    bool chooseForError(double maxRadialError, MeshEstimate& choice) const;
+
+    // Builds only the mesh chooseForBudget picks
+    bool generateForBudget(size_t maxTriangles);
+    // Builds only the mesh chooseForError picks
+    bool generateForError(double maxRadialError);
+
+    // Called with the fraction done before each subdivision pass, returning false cancels the build
+    void setProgressCallback(std::function<bool(float)> callback);
+
+    // Copies a mesh built elsewhere in as the current one, the previous mesh goes to the level cache
+    void adoptMesh(const MeshKey& key, std::vector<float>& newVertices, std::vector<unsigned int>& newIndices, double time);
+    // Copies the current mesh out, leaving this sphere empty until the next generate call
+    void releaseMesh(std::vector<float>& outVertices, std::vector<unsigned int>& outIndices);
+
+    // Makes a cached mesh current, returns false if `key` is not cached
+    bool restoreCached(const MeshKey& key);
+
+    MeshKey getMeshKey() const;
+
+    // Regenerates the current shape and subdivision level with the new mode
+    void setSubdivisionMode(SubdivisionMode mode);
+    SubdivisionMode getSubdivisionMode() const;
+
+    // Number of threads used for subdivision, 0 uses every hardware thread
+    void setThreadCount(unsigned int threadCount);
+    unsigned int getThreadCount() const;
+    // The pool subdivision runs on, for other work of the same thread that should follow the thread count
+    ThreadPool& getThreadPool();
+
+    // Measures how long each worker spends in tasks, to show load imbalance
+    void setTaskTiming(bool enabled);
+    bool getTaskTiming() const;
+    std::vector<WorkerStats> getWorkerStats() const;
+    void resetWorkerStats();
+
+    // Allocations from the scratch arena behind generation and upload buffers
+    ArenaStats getScratchStats() const;
+    // Allocations from the arena behind the current mesh
+    ArenaStats getMeshStats() const;
+
+    // How sendBufferData fills the GPU buffers, and what the last upload cost
+    void setUploadMethod(UploadMethod method);
+    UploadMethod getUploadMethod() const;
+    UploadStats getUploadStats() const;
+
+    // Duration of the last subdivide call in milliseconds
+    double getGenerationTime() const;
+
+    // Memory budget for previously generated levels and their GPU buffers, 0 disables the cache
+    void setCacheBudget(size_t bytes);
+    size_t getCacheBudget() const;
+    size_t getCacheUsedBytes() const;
+    size_t getCachedLevelCount() const;
+
+    // Writes the current mesh to a .sphmesh file, returns false on failure
+    bool save(const std::string& path) const;
+    // Maps a .sphmesh file and uses it as the current mesh without copying it into memory.
+    // Returns false and keeps the current mesh if the file can't be used
+    bool loadMapped(const std::string& path);
+    bool isMapped() const;
+
+    // Layout of the vertex buffer. The CPU copy always keeps full precision
+    void setVertexFormat(VertexFormat format);
+    VertexFormat getVertexFormat() const;
+    size_t getVertexStride() const;
+
+    // Largest distance between a vertex and its decoded position in the last upload
+    float getPositionError() const;
+
+    // Reorders triangles and vertices for vertex cache reuse before each upload
+    void setVertexCacheOptimization(bool enabled);
+    bool getVertexCacheOptimization() const;
+
+    // Simulated cache behaviour of the last optimized mesh, and how long the pass took in milliseconds
+    VertexCacheStats getCacheStatsBefore() const;
+    VertexCacheStats getCacheStatsAfter() const;
+    double getOptimizationTime() const;
+
+    // Splits the mesh into meshlets on upload and draws only those cullClusters keeps
+    void setClusterCulling(bool enabled);
+    bool getClusterCulling() const;
+
+    // Culls meshlets against the camera frustum and facing, called once per frame before render
+    void cullClusters(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition);
+    float getCulledFraction() const;
+    size_t getMeshletCount() const;
+
+    // Refines the adaptive icosphere for the current camera. Returns true if the mesh changed,
+    // which is only checked when the view or the settings changed since the last call
+    bool updateAdaptive(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition, float viewportHeight);
+
+    // Largest projected error in pixels the adaptive icosphere leaves unrefined
+    void setAdaptiveErrorThreshold(float pixels);
+    float getAdaptiveErrorThreshold() const;
+
+    // Sends data to GPU, skipped if the current mesh is already uploaded
     void sendBufferData();
 
     void render(Shader& shader, int modelLocation);
+    // Draws `instanceCount` copies of the whole mesh in one call, placed by the SphereInstance
+    // entries of `instanceBuffer` from `firstInstance` on. The shader's `instanced` flag has to be set
+    void renderInstances(Shader& shader, unsigned int instanceBuffer, size_t firstInstance, size_t instanceCount);
 
     void setPosition(glm::vec3 position);
     void setRotationAxis(glm::vec3 axis);
@@ -42,10 +223,76 @@ public:
     size_t getVertexCount() const;
     size_t getTriangleCount() const;
 
+    // Bytes per index on the GPU, 2 below 65536 vertices and 4 otherwise
+    size_t getIndexWidth() const;
+
     unsigned int getSectors() const;
     unsigned int getStacks() const;
 
+    unsigned int getCubeResolution() const;
+    bool getCubeWarp() const;
+
+    unsigned int getOctaResolution() const;
+
+    // Largest distance between the sphere and the current triangles, relative to the radius
+    double measureSurfaceError();
+
 private:
+    // Regenerates the base shape of the current type
+    void generateBase();
+
+    // Builds the given level from the current mesh or the base shape
+    void buildLevel(unsigned int level);
+    // Replaces the mesh with a compile-time generated icosphere level
+    void loadBakedIcosphere(unsigned int level);
+    // Replaces the mesh with the HEALPix grid at `order`
+    void buildHealpix(unsigned int order);
+    // Replaces the mesh with the octahedron sphere with `segments` divisions per edge
+    void buildOctasphere(unsigned int segments);
+    // Makes the mesh for `key` current, from the level cache when it is there
+    void buildChoice(const MeshKey& key);
+
+    // Sets the type, mode, level and shape parameters from `key` without generating anything
+    void setShape(const MeshKey& key);
+
+    // Copies a mapped mesh into the vertex and index vectors and closes the mapping
+    void copyMapping();
+
+    // Current mesh data, from the mapped file if there is one
+    const float* getVertexData() const;
+    glm::mat4 getModelMatrix() const;
+
+    // Rebuilds the meshlets if culling is enabled and the mesh changed
+    void updateMeshlets();
+
+    // Runs the vertex cache optimizer over the current mesh, one partition per base face
+    void optimizeMesh();
+
+    // Encodes the current mesh into `packed` and updates positionError
+    void encodePositions(std::span<OctahedralVertex> packed);
+
+    // Indices at the width of getIndexWidth(), narrowed into `narrowed` when the source is wider.
+    // `narrowed` needs room for every index in that case
+    const void* getIndexData(std::span<uint16_t> narrowed) const;
+
+    // Moves the current mesh and its buffers into the level cache
+    void parkMesh();
+    // Drops the mesh vectors' storage and resets the arena behind them, for a new base shape
+    void resetMeshStorage();
+    // Moves a cached mesh back in, returns false if it is not cached
+    bool restoreMesh(const MeshKey& key);
+
+    void subdivideDuplicated();
+    void subdivideShared();
+    void subdivideDirect(unsigned int level);
+
+    // Returns the index of the midpoint of edge (a, b), creating it if needed
+    unsigned int addMidpoint(unsigned int a, unsigned int b);
+
+    glm::vec3 getVertex(size_t index) const;
+    void setVertex(size_t index, glm::vec3 vertex);
+    void setIndices(size_t triangle, unsigned int a, unsigned int b, unsigned int c);
+
     // Find the midpoint betwen two vertices with constant distsancce from center
     static glm::vec3 findMidpoint(const glm::vec3& a, const glm::vec3& b);
 
@@ -55,17 +302,74 @@ private:
 
     float radius = 1.0f;
     unsigned int subdivisions = 0;
+    SubdivisionMode subdivisionMode = SubdivisionMode::SharedVertices;
 
     SphereType type = SphereType::IcoSphere;
     unsigned int sectors {};
     unsigned int stacks {};
+    unsigned int cubeResolution = 1;
+    bool cubeWarp = false;
+    unsigned int octaResolution = 1;
+    size_t fibonacciPoints = 0;
+
+    // Storage of the mesh vectors below. It is reset whenever a new base shape is generated,
+    // so switching sphere types reuses the blocks of the previous one instead of the heap
+    Arena meshArena {};
+
+    ArenaVector<float> vertices {meshArena};
+    ArenaVector<unsigned int> indices {meshArena};
+
+    // Previous subdivision level, swapped with vertices/indices on every pass
+    ArenaVector<float> backVertices {meshArena};
+    ArenaVector<unsigned int> backIndices {meshArena};
+
+    // Buffers that only live for one generation pass or one upload. Each pass resets it
+    // at the start, so after the first few passes generation doesn't allocate them again
+    Arena scratchArena {};
+
+    MidpointCache midpointCache {};
+    // Endpoints of each midpoint created in the current subdivision pass, from scratchArena
+    std::span<unsigned int> midpointEdges {};
+    size_t midpointCount = 0;
+
+    VertexFormat vertexFormat = VertexFormat::Float3;
+    float positionError = 0.0f;
+
+    MeshOptimizer meshOptimizer {};
+    bool vertexCacheOptimization = false;
+    VertexCacheStats cacheStatsBefore {};
+    VertexCacheStats cacheStatsAfter {};
+    double optimizationTime = 0.0;
+
+    AdaptiveRefiner adaptiveRefiner {};
+    // View the adaptive mesh was last refined for, compared to skip unchanged frames
+    AdaptiveView adaptiveView {};
+    bool adaptiveDirty = true;
+
+    MeshletSet meshlets {};
+    bool clusterCulling = false;
+    // Set when the mesh changed since the meshlets were built
+    bool meshletsDirty = true;
+    // Index counts and byte offsets of the visible runs, for glMultiDrawElements
+    std::vector<int> drawCounts {};
+    std::vector<const void*> drawOffsets {};
+    float culledFraction = 0.0f;
+
+    ThreadPool threadPool {};
+    double generationTime = 0.0;
+    std::function<bool(float)> progressCallback {};
+
+    MeshCache meshCache {};
+
+    // Set while the current mesh lives in a mapped .sphmesh file instead of the vectors
+    MeshFile mappedFile {};
 
-    std::vector<float> vertices {};
-    std::vector<unsigned int> indices {};
+    // GPU buffers of the current mesh, and whether they hold stale data
+    MeshBuffers buffers {};
+    bool buffersDirty = true;
 
-    unsigned int VAO = 0;
-    unsigned int VBO = 0;
-    unsigned int EBO = 0;
+    // Fills the buffers, reusing their storage and staging memory between uploads
+    BufferUploader uploader {};
 
     glm::vec3 position {0.0f, 0.0f, 0.0f};
     glm::vec3 rotationAxis {1.0f, 0.0f, 0.0f};
@@ -0,0 +1,221 @@
+#include "sphere_culling.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <bit>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+// Entry m holds the positions of the set bits of m, lowest first, one per 4 bits
+static constexpr std::array<uint32_t, 256> makeCompactionTable()
+{
+	std::array<uint32_t, 256> table {};
+
+	for (uint32_t mask = 0; mask < 256; mask++)
+	{
+		uint32_t slot = 0;
+
+		for (uint32_t bit = 0; bit < 8; bit++)
+		{
+			if (mask & (1u << bit))
+				table[mask] |= bit << (4 * slot++);
+		}
+	}
+
+	return table;
+}
+
+static constexpr std::array<uint32_t, 256> compactionTable = makeCompactionTable();
+
+static bool sphereVisible(const std::array<glm::vec4, 6>& planes, float x, float y, float z, float radius)
+{
+	bool inside = true;
+
+	// Same order of operations as the AVX2 path, so both agree on spheres touching a plane
+	for (const glm::vec4& plane : planes)
+		inside = inside && ((plane.x * x + plane.w + radius) + plane.y * y) + plane.z * z >= 0.0f;
+
+	return inside;
+}
+
+// Writes base + i for every set bit i of each mask, returns the end of the written indices
+static uint32_t* expandMasks(const uint8_t* masks, size_t groupCount, uint32_t base, uint32_t* out)
+{
+	for (size_t group = 0; group < groupCount; group++, base += 8)
+	{
+		for (uint32_t mask = masks[group]; mask != 0; mask &= mask - 1)
+			*out++ = base + static_cast<uint32_t>(std::countr_zero(mask));
+	}
+
+	return out;
+}
+
+#ifdef CPU_FEATURES_X86
+
+// Masks for the first count / 8 groups of 8 spheres, returns how many spheres it handled
+TARGET_AVX2 static size_t testSpheresAVX2(const std::array<glm::vec4, 6>& planes,
+	const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* masks)
+{
+	__m256 a[6], b[6], c[6], d[6];
+
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = _mm256_set1_ps(planes[p].x);
+		b[p] = _mm256_set1_ps(planes[p].y);
+		c[p] = _mm256_set1_ps(planes[p].z);
+		d[p] = _mm256_set1_ps(planes[p].w);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 vz = _mm256_loadu_ps(z + i);
+		__m256 vr = _mm256_loadu_ps(radius + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], vx), d[p]), vr);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(b[p], vy));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(c[p], vz));
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+		}
+
+		masks[i / 8] = static_cast<uint8_t>(_mm256_movemask_ps(inside));
+	}
+
+	return i;
+}
+
+// expandMasks eight indices at a time. The vector store runs past the last index, so it is
+// only used while there are 8 slots left before `outEnd`
+TARGET_AVX2 static uint32_t* expandMasksAVX2(const uint8_t* masks, size_t groupCount, uint32_t base, uint32_t* out, uint32_t* outEnd)
+{
+	const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256i lowBits = _mm256_set1_epi32(7);
+
+	for (size_t group = 0; group < groupCount; group++, base += 8)
+	{
+		const uint32_t mask = masks[group];
+
+		if (out + 8 > outEnd)
+			return expandMasks(masks + group, groupCount - group, base, out);
+
+		__m256i bits = _mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(compactionTable[mask])), shifts);
+		__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(base)), _mm256_and_si256(bits, lowBits));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), indices);
+		out += std::popcount(mask);
+	}
+
+	return out;
+}
+
+#endif
+
+std::span<const uint32_t> SphereCuller::cull(ThreadPool& threadPool,
+	const std::array<glm::vec4, 6>& planes,
+	const float* x,
+	const float* y,
+	const float* z,
+	const float* radius,
+	size_t count)
+{
+	const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	masks.resize((count + 7) / 8);
+	chunkOffsets.resize(chunkCount);
+
+	if (visible.size() < count)
+		visible.resize(count);
+
+	bool avx2 = false;
+
+#ifdef CPU_FEATURES_X86
+	avx2 = cpuSupportsAVX2();
+#endif
+
+	// Test every sphere and count the visible ones per chunk
+	threadPool.parallelFor(chunkCount, [&](size_t begin, size_t end)
+	{
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			const size_t first = chunk * chunkSize;
+			const size_t size = std::min(chunkSize, count - first);
+			uint8_t* chunkMasks = masks.data() + first / 8;
+
+			size_t done = 0;
+
+#ifdef CPU_FEATURES_X86
+			if (avx2)
+				done = testSpheresAVX2(planes, x + first, y + first, z + first, radius + first, size, chunkMasks);
+#endif
+
+			for (size_t i = done; i < size; i += 8)
+			{
+				uint8_t mask = 0;
+
+				for (size_t j = i; j < std::min(i + 8, size); j++)
+				{
+					if (sphereVisible(planes, x[first + j], y[first + j], z[first + j], radius[first + j]))
+						mask |= static_cast<uint8_t>(1u << (j - i));
+				}
+
+				chunkMasks[i / 8] = mask;
+			}
+
+			size_t visibleCount = 0;
+
+			for (size_t group = 0; group < (size + 7) / 8; group++)
+				visibleCount += static_cast<size_t>(std::popcount(chunkMasks[group]));
+
+			chunkOffsets[chunk] = visibleCount;
+		}
+	});
+
+	size_t total = 0;
+
+	for (size_t& offset : chunkOffsets)
+	{
+		size_t chunkVisible = offset;
+		offset = total;
+		total += chunkVisible;
+	}
+
+	// Each chunk writes its indices straight to their place in the list
+	threadPool.parallelFor(chunkCount, [&](size_t begin, size_t end)
+	{
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			const size_t first = chunk * chunkSize;
+			const size_t groupCount = (std::min(chunkSize, count - first) + 7) / 8;
+
+			const uint8_t* chunkMasks = masks.data() + first / 8;
+			const uint32_t base = static_cast<uint32_t>(first);
+
+			uint32_t* out = visible.data() + chunkOffsets[chunk];
+			uint32_t* outEnd = visible.data() + (chunk + 1 < chunkCount ? chunkOffsets[chunk + 1] : total);
+
+#ifdef CPU_FEATURES_X86
+			if (avx2)
+			{
+				expandMasksAVX2(chunkMasks, groupCount, base, out, outEnd);
+				continue;
+			}
+#endif
+
+			expandMasks(chunkMasks, groupCount, base, out);
+		}
+	});
+
+	return {visible.data(), total};
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "thread_pool.h"
+
+// Tests bounding spheres stored as separate center and radius arrays against a frustum,
+// eight at a time with AVX2 when the CPU has it, and compacts the visible ones into a list
+class SphereCuller
+{
+public:
+	SphereCuller() = default;
+
+	// Indices of the spheres touching the frustum given by `planes` (as Camera::getFrustumPlanes),
+	// in increasing order. Valid until the next call
+	std::span<const uint32_t> cull(ThreadPool& threadPool,
+		const std::array<glm::vec4, 6>& planes,
+		const float* x,
+		const float* y,
+		const float* z,
+		const float* radius,
+		size_t count);
+
+private:
+	// Spheres per task, a multiple of 8 so every mask byte belongs to one chunk
+	static constexpr size_t chunkSize = 16384;
+
+	// Bit i of byte k is set if sphere 8k + i is visible
+	std::vector<uint8_t> masks {};
+	// Visible spheres per chunk, then where each chunk writes its indices
+	std::vector<size_t> chunkOffsets {};
+	std::vector<uint32_t> visible {};
+};
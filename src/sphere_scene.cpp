@@ -0,0 +1,284 @@
+#include "sphere_scene.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <random>
+
+void SphereScene::init()
+{
+	glGenBuffers(1, &instanceBuffer);
+}
+
+uint32_t SphereScene::addMesh(Sphere& sphere)
+{
+	meshes.push_back(&sphere);
+	dirty = true;
+
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+size_t SphereScene::addInstance(uint32_t mesh, glm::vec3 center, float radius, glm::vec3 rotationAxis, float rotationAngle)
+{
+	const float s = std::sin(rotationAngle * 0.5f);
+
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	radii.push_back(radius);
+	rotationX.push_back(rotationAxis.x * s);
+	rotationY.push_back(rotationAxis.y * s);
+	rotationZ.push_back(rotationAxis.z * s);
+	rotationW.push_back(std::cos(rotationAngle * 0.5f));
+	meshIndices.push_back(mesh);
+
+	dirty = true;
+	return meshIndices.size() - 1;
+}
+
+void SphereScene::clear()
+{
+	for (std::vector<float>* component : {&centerX, &centerY, &centerZ, &radii, &rotationX, &rotationY, &rotationZ, &rotationW})
+		component->clear();
+
+	meshIndices.clear();
+	dirty = true;
+}
+
+void SphereScene::scatter(ThreadPool& threadPool, uint32_t mesh, size_t count, float extent, float minRadius, float maxRadius, uint32_t seed)
+{
+	for (std::vector<float>* component : {&centerX, &centerY, &centerZ, &radii, &rotationX, &rotationY, &rotationZ, &rotationW})
+		component->resize(count);
+
+	meshIndices.assign(count, mesh);
+
+	const size_t chunkCount = (count + packChunkSize - 1) / packChunkSize;
+
+	// One generator per chunk, so the result doesn't depend on the thread count
+	threadPool.parallelFor(chunkCount, [&](size_t begin, size_t end)
+	{
+		std::uniform_real_distribution<float> coordinate(-0.5f * extent, 0.5f * extent);
+		std::uniform_real_distribution<float> radius(minRadius, maxRadius);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> angle(0.0f, 2.0f * std::numbers::pi_v<float>);
+
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			std::mt19937 generator(static_cast<uint32_t>(seed * 2654435761u + chunk));
+
+			const size_t last = std::min((chunk + 1) * packChunkSize, count);
+
+			for (size_t i = chunk * packChunkSize; i < last; i++)
+			{
+				centerX[i] = coordinate(generator);
+				centerY[i] = coordinate(generator);
+				centerZ[i] = coordinate(generator);
+				radii[i] = radius(generator);
+
+				// Uniform axis from a height and an angle around the y axis
+				float y = unit(generator);
+				float ring = std::sqrt(std::max(1.0f - y * y, 0.0f));
+				float around = angle(generator);
+				float halfTurn = angle(generator) * 0.5f;
+				float s = std::sin(halfTurn);
+
+				rotationX[i] = ring * std::cos(around) * s;
+				rotationY[i] = y * s;
+				rotationZ[i] = ring * std::sin(around) * s;
+				rotationW[i] = std::cos(halfTurn);
+			}
+		}
+	});
+
+	dirty = true;
+}
+
+void SphereScene::spin(ThreadPool& threadPool, float angle)
+{
+	const float c = std::cos(angle * 0.5f);
+	const float s = std::sin(angle * 0.5f);
+
+	// Multiplies every rotation by (0, s, 0, c) from the left
+	threadPool.parallelFor(getInstanceCount(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const float x = rotationX[i];
+			const float y = rotationY[i];
+			const float z = rotationZ[i];
+			const float w = rotationW[i];
+
+			rotationX[i] = c * x + s * z;
+			rotationY[i] = c * y + s * w;
+			rotationZ[i] = c * z - s * x;
+			rotationW[i] = c * w - s * y;
+		}
+	});
+
+	dirty = true;
+}
+
+size_t SphereScene::getInstanceCount() const
+{
+	return meshIndices.size();
+}
+
+void SphereScene::setUploadMethod(UploadMethod method)
+{
+	uploader.setMethod(method);
+}
+
+UploadStats SphereScene::getUploadStats() const
+{
+	return uploader.getStats();
+}
+
+void SphereScene::setCulling(bool enabled)
+{
+	culling = enabled;
+	dirty = true;
+}
+
+bool SphereScene::getCulling() const
+{
+	return culling;
+}
+
+void SphereScene::setFrustum(const std::array<glm::vec4, 6>& planes)
+{
+	if (culling && planes != frustum)
+		dirty = true;
+
+	frustum = planes;
+}
+
+void SphereScene::upload(ThreadPool& threadPool)
+{
+	// Instances need a mesh to be drawn with
+	if (!dirty || meshes.empty())
+		return;
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (culling)
+	{
+		visibleInstances = culler.cull(threadPool, frustum,
+			centerX.data(), centerY.data(), centerZ.data(), radii.data(), getInstanceCount());
+
+		auto cullEndTime = std::chrono::steady_clock::now();
+		cullTime = std::chrono::duration<double, std::milli>(cullEndTime - startTime).count();
+	}
+
+	// Entry k of the draw list is instance order[k], or instance k without culling
+	const uint32_t* order = culling ? visibleInstances.data() : nullptr;
+
+	const size_t count = culling ? visibleInstances.size() : getInstanceCount();
+	const size_t meshCount = meshes.size();
+	const size_t chunkCount = (count + packChunkSize - 1) / packChunkSize;
+
+	packed.resize(count);
+	meshOffsets.assign(meshCount, 0);
+	meshCounts.assign(meshCount, 0);
+	chunkCounts.assign(chunkCount * meshCount, 0);
+
+	// Counting sort by mesh: count per chunk, turn the counts into write positions that keep
+	// each mesh's instances in order, then pack every chunk into its positions.
+	// With a single mesh every chunk simply starts at its first instance
+	if (meshCount == 1)
+	{
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			chunkCounts[chunk] = chunk * packChunkSize;
+
+		meshCounts[0] = count;
+	}
+	else
+	{
+		threadPool.parallelFor(chunkCount, [&](size_t begin, size_t end)
+		{
+			for (size_t chunk = begin; chunk < end; chunk++)
+			{
+				const size_t last = std::min((chunk + 1) * packChunkSize, count);
+
+				for (size_t k = chunk * packChunkSize; k < last; k++)
+					chunkCounts[chunk * meshCount + meshIndices[order ? order[k] : k]]++;
+			}
+		});
+
+		size_t offset = 0;
+
+		for (size_t mesh = 0; mesh < meshCount; mesh++)
+		{
+			meshOffsets[mesh] = offset;
+
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				size_t instances = chunkCounts[chunk * meshCount + mesh];
+				chunkCounts[chunk * meshCount + mesh] = offset;
+				offset += instances;
+			}
+
+			meshCounts[mesh] = offset - meshOffsets[mesh];
+		}
+	}
+
+	threadPool.parallelFor(chunkCount, [&](size_t begin, size_t end)
+	{
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			const size_t last = std::min((chunk + 1) * packChunkSize, count);
+
+			for (size_t k = chunk * packChunkSize; k < last; k++)
+			{
+				const size_t i = order ? order[k] : k;
+				size_t& position = chunkCounts[chunk * meshCount + meshIndices[i]];
+
+				SphereInstance& instance = packed[position++];
+				instance.center = {centerX[i], centerY[i], centerZ[i]};
+				instance.radius = radii[i];
+				instance.rotation = {rotationX[i], rotationY[i], rotationZ[i], rotationW[i]};
+			}
+		}
+	});
+
+	const size_t bytes = count * sizeof(SphereInstance);
+
+	uploader.begin(bytes);
+	uploader.upload(threadPool, GL_ARRAY_BUFFER, instanceBuffer, instanceCapacity, packed.data(), bytes);
+	uploader.end();
+
+	dirty = false;
+
+	auto endTime = std::chrono::steady_clock::now();
+	uploadTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+double SphereScene::getUploadTime() const
+{
+	return uploadTime;
+}
+
+double SphereScene::getCullTime() const
+{
+	return cullTime;
+}
+
+size_t SphereScene::getVisibleCount() const
+{
+	return packed.size();
+}
+
+void SphereScene::render(Shader& shader)
+{
+	if (instanceBuffer == 0 || packed.empty())
+		return;
+
+	shader.setBool("instanced", true);
+
+	// Meshes added since the last upload have no instances in the buffer yet
+	for (size_t mesh = 0; mesh < meshCounts.size(); mesh++)
+		meshes[mesh]->renderInstances(shader, instanceBuffer, meshOffsets[mesh], meshCounts[mesh]);
+
+	shader.setBool("instanced", false);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "sphere.h"
+#include "shader.h"
+#include "thread_pool.h"
+#include "buffer_upload.h"
+#include "sphere_culling.h"
+
+// Many copies of sphere meshes, each with its own position, radius and rotation. Instances are
+// stored one array per component, packed into a single instance buffer at most once per frame,
+// and every mesh is drawn once for all of its instances
+class SphereScene
+{
+public:
+	SphereScene() = default;
+
+	void init();
+
+	// Makes `sphere` drawable by instances, which refer to it by the returned index.
+	// Its mesh is drawn as it is at render time
+	uint32_t addMesh(Sphere& sphere);
+
+	// `rotationAxis` must be a unit vector
+	size_t addInstance(uint32_t mesh, glm::vec3 center, float radius, glm::vec3 rotationAxis = {0.0f, 1.0f, 0.0f}, float rotationAngle = 0.0f);
+	void clear();
+
+	// Replaces the instances with `count` spheres of `mesh` spread uniformly over a cube of side
+	// `extent` around the origin, with radii in [minRadius, maxRadius] and random rotations
+	void scatter(ThreadPool& threadPool, uint32_t mesh, size_t count, float extent, float minRadius, float maxRadius, uint32_t seed = 1);
+
+	// Turns every instance by `angle` radians about the world y axis through its center
+	void spin(ThreadPool& threadPool, float angle);
+
+	size_t getInstanceCount() const;
+
+	// Instance buffer method, shared with the meshes through BufferUploader
+	void setUploadMethod(UploadMethod method);
+	UploadStats getUploadStats() const;
+
+	// Leaves out instances outside the frustum when packing, so only visible ones are drawn
+	void setCulling(bool enabled);
+	bool getCulling() const;
+	// Frustum planes the next upload culls against, as Camera::getFrustumPlanes
+	void setFrustum(const std::array<glm::vec4, 6>& planes);
+
+	// Culls, packs and uploads the instances if they or the frustum changed since the last call,
+	// grouped by mesh
+	void upload(ThreadPool& threadPool);
+	// Duration of the last upload including culling and packing, in milliseconds
+	double getUploadTime() const;
+	double getCullTime() const;
+
+	// Instances in the instance buffer, all of them when culling is off
+	size_t getVisibleCount() const;
+
+	// One instanced draw per mesh that has instances
+	void render(Shader& shader);
+
+private:
+	// Instances packed per mesh are split into tasks of this many
+	static constexpr size_t packChunkSize = 16384;
+
+	std::vector<Sphere*> meshes {};
+
+	std::vector<float> centerX {};
+	std::vector<float> centerY {};
+	std::vector<float> centerZ {};
+	std::vector<float> radii {};
+	// Unit quaternions
+	std::vector<float> rotationX {};
+	std::vector<float> rotationY {};
+	std::vector<float> rotationZ {};
+	std::vector<float> rotationW {};
+	std::vector<uint32_t> meshIndices {};
+
+	SphereCuller culler {};
+	bool culling = false;
+	std::array<glm::vec4, 6> frustum {};
+	// Indices of the instances that passed the last cull
+	std::span<const uint32_t> visibleInstances {};
+
+	// Instances in buffer order, and where each mesh's run starts
+	std::vector<SphereInstance> packed {};
+	std::vector<size_t> meshOffsets {};
+	std::vector<size_t> meshCounts {};
+	// Instances of each mesh in each chunk, then where the chunk writes them
+	std::vector<size_t> chunkCounts {};
+
+	unsigned int instanceBuffer = 0;
+	size_t instanceCapacity = 0;
+	BufferUploader uploader {};
+
+	bool dirty = true;
+	double uploadTime = 0.0;
+	double cullTime = 0.0;
+};
@@ -0,0 +1,315 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Which pool and deque the current thread works for
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	start(threadCount);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+}
+
+void ThreadPool::setThreadCount(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Restarting joins every worker, so it only happens when the count changes
+	if (threadCount == this->threadCount)
+		return;
+
+	stop();
+	start(threadCount);
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+	return threadCount;
+}
+
+void ThreadPool::setTimingEnabled(bool enabled)
+{
+	timingEnabled = enabled;
+}
+
+bool ThreadPool::getTimingEnabled() const
+{
+	return timingEnabled;
+}
+
+void ThreadPool::setTimingHook(std::function<void(const TaskTiming&)> hook)
+{
+	timingHook = std::move(hook);
+}
+
+std::vector<WorkerStats> ThreadPool::getWorkerStats() const
+{
+	std::vector<WorkerStats> stats(queues.size());
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		stats[i].busyMilliseconds = static_cast<double>(queues[i]->busyNanoseconds.load()) / 1e6;
+		stats[i].taskCount = queues[i]->taskCount.load();
+	}
+
+	return stats;
+}
+
+void ThreadPool::resetWorkerStats()
+{
+	for (std::unique_ptr<WorkerQueue>& queue : queues)
+	{
+		queue->busyNanoseconds = 0;
+		queue->taskCount = 0;
+	}
+}
+
+void ThreadPool::run(size_t count, void* context, Invoker invoker)
+{
+	if (count == 0)
+		return;
+
+	// A few chunks per thread evens out ranges that take longer than others,
+	// and stealing moves the rest to whichever worker runs out first
+	size_t numChunks = workers.empty() ? 1 : std::min<size_t>(static_cast<size_t>(threadCount) * 4, count);
+	size_t chunkSize = (count + numChunks - 1) / numChunks;
+	numChunks = (count + chunkSize - 1) / chunkSize;
+
+	std::atomic<size_t> pending = numChunks;
+
+	auto chunkTask = [&](size_t chunk) -> Task
+	{
+		size_t begin = chunk * chunkSize;
+		return {invoker, context, begin, std::min(begin + chunkSize, count), &pending};
+	};
+
+	// The owner pops from the back, so push the ranges last to first and it works front to back
+	// while thieves take the ranges furthest from it
+	size_t queued = 0;
+
+	while (queued < numChunks && push(chunkTask(numChunks - 1 - queued)))
+		queued++;
+
+	if (queued > 0)
+		wake();
+
+	// Ranges that didn't fit are the first ones, which this thread would have started with anyway
+	for (size_t chunk = 0; chunk < numChunks - queued; chunk++)
+		execute(chunkTask(chunk), getCurrentWorker());
+
+	waitFor(pending);
+}
+
+bool ThreadPool::push(const Task& task)
+{
+	// Counted before it is queued, so a thief never takes the count below zero
+	queuedTasks++;
+
+	WorkerQueue& queue = *queues[getCurrentWorker()];
+	std::lock_guard lock(queue.mutex);
+
+	if (queue.size == queueCapacity)
+	{
+		queuedTasks--;
+		return false;
+	}
+
+	queue.tasks[(queue.first + queue.size) % queueCapacity] = task;
+	queue.size++;
+
+	return true;
+}
+
+void ThreadPool::wake()
+{
+	if (workers.empty())
+		return;
+
+	// Taking the lock orders the push before any worker's check of queuedTasks
+	{
+		std::lock_guard lock(mutex);
+	}
+
+	wakeCondition.notify_all();
+}
+
+bool ThreadPool::runOne()
+{
+	const unsigned int self = getCurrentWorker();
+	const size_t queueCount = queues.size();
+
+	Task task {};
+	bool found = false;
+
+	{
+		WorkerQueue& queue = *queues[self];
+		std::lock_guard lock(queue.mutex);
+
+		if (queue.size > 0)
+		{
+			queue.size--;
+			task = queue.tasks[(queue.first + queue.size) % queueCapacity];
+			found = true;
+		}
+	}
+
+	for (size_t i = 1; i < queueCount && !found; i++)
+	{
+		WorkerQueue& victim = *queues[(self + i) % queueCount];
+		std::lock_guard lock(victim.mutex);
+
+		if (victim.size > 0)
+		{
+			task = victim.tasks[victim.first];
+			victim.first = (victim.first + 1) % queueCapacity;
+			victim.size--;
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queuedTasks--;
+	execute(task, self);
+
+	return true;
+}
+
+void ThreadPool::waitFor(const std::atomic<size_t>& pending)
+{
+	while (pending.load(std::memory_order_acquire) != 0)
+	{
+		if (runOne())
+			continue;
+
+		// The remaining tasks are running elsewhere, sleep until one finishes or more are queued
+		std::unique_lock lock(mutex);
+		wakeCondition.wait(lock, [&] { return pending.load(std::memory_order_acquire) == 0 || queuedTasks > 0; });
+	}
+}
+
+void ThreadPool::execute(const Task& task, unsigned int worker)
+{
+	if (timingEnabled.load(std::memory_order_relaxed))
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		task.invoker(task.context, task.begin, task.end);
+		auto endTime = std::chrono::steady_clock::now();
+
+		auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+		WorkerQueue& queue = *queues[worker];
+		queue.busyNanoseconds += static_cast<uint64_t>(nanoseconds);
+		queue.taskCount++;
+
+		if (timingHook)
+			timingHook({worker, task.begin, task.end, static_cast<double>(nanoseconds) / 1e6});
+	}
+	else
+	{
+		task.invoker(task.context, task.begin, task.end);
+	}
+
+	// The waiter may return as soon as this reaches zero, so `task.pending` isn't touched after it
+	if (task.pending->fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		{
+			std::lock_guard lock(mutex);
+		}
+
+		wakeCondition.notify_all();
+	}
+}
+
+unsigned int ThreadPool::getCurrentWorker() const
+{
+	return currentPool == this ? currentWorker : 0;
+}
+
+void ThreadPool::start(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	this->threadCount = threadCount;
+	stopping = false;
+
+	queues.clear();
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		queues.push_back(std::make_unique<WorkerQueue>());
+
+	// The calling thread is the first worker
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+
+	wakeCondition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	workers.clear();
+}
+
+void ThreadPool::workerLoop(unsigned int worker)
+{
+	currentPool = this;
+	currentWorker = worker;
+
+	while (true)
+	{
+		if (runOne())
+			continue;
+
+		std::unique_lock lock(mutex);
+		wakeCondition.wait(lock, [this] { return stopping || queuedTasks > 0; });
+
+		if (stopping)
+			return;
+	}
+}
+
+TaskGroup::TaskGroup(ThreadPool& threadPool)
+	: threadPool(threadPool)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	wait();
+}
+
+void TaskGroup::submit(void* context, ThreadPool::Invoker invoker)
+{
+	pending++;
+
+	ThreadPool::Task task {invoker, context, 0, 1, &pending};
+
+	// Without workers the tasks run right away, in order, as they do when the deque is full
+	if (threadPool.workers.empty() || !threadPool.push(task))
+		threadPool.execute(task, threadPool.getCurrentWorker());
+	else
+		threadPool.wake();
+}
+
+void TaskGroup::wait()
+{
+	threadPool.waitFor(pending);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Time spent in tasks by one worker since the last reset, while timing is enabled
+struct WorkerStats
+{
+	double busyMilliseconds = 0.0;
+	size_t taskCount = 0;
+};
+
+// One finished task, as passed to the timing hook
+struct TaskTiming
+{
+	unsigned int worker = 0;
+	// Index range of a parallelFor chunk, [0, 1) for a task group task
+	size_t begin = 0;
+	size_t end = 0;
+	double milliseconds = 0.0;
+};
+
+// Work-stealing task scheduler. Every worker has its own deque, pushes and pops its own
+// tasks at the back and steals from the front of the others when it runs out.
+// Threads outside the pool share the first deque and help with the work while they wait.
+// The deques have a fixed size, so queueing work never allocates
+class ThreadPool
+{
+public:
+	// A thread count of 0 uses one thread per hardware thread
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Thread count includes the calling thread. With a count of 1 every task
+	// runs inline on the calling thread in submission order
+	void setThreadCount(unsigned int threadCount);
+	unsigned int getThreadCount() const;
+
+	// Splits [0, count) into contiguous ranges, runs `function(begin, end)` on each of them
+	// and returns once all ranges are done. Can be nested inside other tasks
+	template <typename Function>
+	void parallelFor(size_t count, Function&& function)
+	{
+		// The function is only referenced for the duration of the call, so nothing is allocated
+		using FunctionType = std::remove_reference_t<Function>;
+
+		run(count, const_cast<void*>(static_cast<const void*>(&function)), [](void* context, size_t begin, size_t end)
+		{
+			(*static_cast<FunctionType*>(context))(begin, end);
+		});
+	}
+
+	// Measures every task, off by default since it reads the clock twice per task
+	void setTimingEnabled(bool enabled);
+	bool getTimingEnabled() const;
+
+	// Called after each measured task on the thread that ran it. Only set it while the pool is idle
+	void setTimingHook(std::function<void(const TaskTiming&)> hook);
+
+	// One entry per worker, the first one is the calling thread
+	std::vector<WorkerStats> getWorkerStats() const;
+	void resetWorkerStats();
+
+private:
+	friend class TaskGroup;
+
+	using Invoker = void (*)(void* context, size_t begin, size_t end);
+
+	// Tasks one deque holds. Tasks that don't fit run right away on the thread that made them
+	static constexpr size_t queueCapacity = 1024;
+
+	struct Task
+	{
+		Invoker invoker = nullptr;
+		void* context = nullptr;
+		size_t begin = 0;
+		size_t end = 0;
+		// Tasks of the same parallelFor or group that haven't finished yet
+		std::atomic<size_t>* pending = nullptr;
+	};
+
+	struct alignas(64) WorkerQueue
+	{
+		std::mutex mutex {};
+		// Ring of queued tasks, the oldest at `first`
+		std::array<Task, queueCapacity> tasks {};
+		size_t first = 0;
+		size_t size = 0;
+
+		std::atomic<uint64_t> busyNanoseconds = 0;
+		std::atomic<size_t> taskCount = 0;
+	};
+
+	void run(size_t count, void* context, Invoker invoker);
+
+	// Queues a task on the deque of the calling thread, false if the deque is full
+	bool push(const Task& task);
+	// Lets sleeping workers know that tasks were pushed
+	void wake();
+	// Runs one task of the calling thread, or one stolen from another worker.
+	// Returns false if there was nothing to run
+	bool runOne();
+	// Runs tasks until `pending` reaches zero
+	void waitFor(const std::atomic<size_t>& pending);
+	void execute(const Task& task, unsigned int worker);
+
+	// Index of the calling thread's deque, 0 for threads outside the pool
+	unsigned int getCurrentWorker() const;
+
+	void start(unsigned int threadCount);
+	void stop();
+
+	void workerLoop(unsigned int worker);
+
+	std::vector<std::thread> workers {};
+	std::vector<std::unique_ptr<WorkerQueue>> queues {};
+	unsigned int threadCount = 1;
+
+	// Guards sleeping only, the deques have their own locks
+	std::mutex mutex {};
+	std::condition_variable wakeCondition {};
+
+	// Counts tasks before they are pushed and after they are popped, so it never undercounts
+	std::atomic<size_t> queuedTasks = 0;
+	bool stopping = false;
+
+	std::atomic<bool> timingEnabled = false;
+	std::function<void(const TaskTiming&)> timingHook {};
+};
+
+// Independent tasks on a thread pool that are waited on together
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& threadPool);
+	// Waits for the tasks that are still running
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	// Queues `function`, which may use the same pool itself. Like parallelFor it is only
+	// referenced, so it has to live until wait() returns. Called from one thread only
+	template <typename Function>
+	void run(Function& function)
+	{
+		submit(const_cast<void*>(static_cast<const void*>(&function)), [](void* context, size_t, size_t)
+		{
+			(*static_cast<Function*>(context))();
+		});
+	}
+
+	// A temporary would be gone before its task runs
+	template <typename Function>
+	void run(const Function&&) = delete;
+
+	// Helps with queued work until every task of the group has finished
+	void wait();
+
+private:
+	void submit(void* context, ThreadPool::Invoker invoker);
+
+	ThreadPool& threadPool;
+	std::atomic<size_t> pending = 0;
+};
+
+// Raises `target` to `value` if it is larger, for combining per-task results of a parallelFor
+template <typename T>
+void atomicMax(std::atomic<T>& target, T value)
+{
+	T current = target.load();
+
+	while (value > current && !target.compare_exchange_weak(current, value))
+	{
+	}
+}
@@ -0,0 +1,127 @@
+#include "sphere.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Every allocation of the standard containers and the thread pool goes through these
+static std::atomic<size_t> allocationCount = 0;
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	allocationCount++;
+
+	const size_t align = static_cast<size_t>(alignment);
+
+	if (void* memory = std::aligned_alloc(align, (size + align - 1) / align * align))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+// Levels 0 to maxLevel are rebuilt several times in each mode. Once the first rounds have grown
+// the buffers, a round must not allocate at all
+static constexpr unsigned int maxLevel = 6;
+static constexpr int warmupRounds = 2;
+static constexpr int checkedRounds = 2;
+
+// Switching sphere types resets the mesh arena, so a round over every type must not allocate either
+static void generateEveryType(Sphere& sphere)
+{
+	sphere.generateCubesphere(16, true);
+	sphere.subdivide(3);
+	sphere.generateSectorsphere(64, 32);
+	sphere.generateHealpixSphere(16);
+	sphere.generateOctasphere(8);
+	sphere.generateFibonacciSphere(4096);
+	sphere.generateIcosphere();
+	sphere.subdivide(maxLevel);
+}
+
+int main()
+{
+	const SubdivisionMode modes[] {SubdivisionMode::Duplicated, SubdivisionMode::SharedVertices, SubdivisionMode::Direct};
+	const char* modeNames[] {"Duplicated", "SharedVertices", "Direct"};
+
+	bool passed = true;
+
+	for (size_t m = 0; m < std::size(modes); m++)
+	{
+		// Cached levels would be restored instead of subdivided
+		Sphere sphere;
+		sphere.setCacheBudget(0);
+		sphere.setThreadCount(4);
+		sphere.setSubdivisionMode(modes[m]);
+		sphere.generateIcosphere();
+
+		for (int round = 0; round < warmupRounds + checkedRounds; round++)
+		{
+			const size_t before = allocationCount;
+
+			sphere.subdivide(0);
+
+			for (unsigned int level = 1; level <= maxLevel; level++)
+				sphere.subdivide(level);
+
+			const size_t allocations = allocationCount - before;
+
+			if (round >= warmupRounds && allocations != 0)
+			{
+				std::cout << modeNames[m] << ": " << allocations << " allocations in warm round " << round << "\n";
+				passed = false;
+			}
+		}
+	}
+
+	Sphere sphere;
+	sphere.setCacheBudget(0);
+	sphere.setThreadCount(4);
+
+	for (int round = 0; round < warmupRounds + checkedRounds; round++)
+	{
+		const size_t before = allocationCount;
+
+		generateEveryType(sphere);
+
+		const size_t allocations = allocationCount - before;
+
+		if (round >= warmupRounds && allocations != 0)
+		{
+			std::cout << "Type switches: " << allocations << " allocations in warm round " << round << "\n";
+			passed = false;
+		}
+	}
+
+	return passed ? 0 : 1;
+}
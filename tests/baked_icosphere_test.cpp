@@ -0,0 +1,58 @@
+#include "baked_icosphere.h"
+#include "midpoint_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// The baked levels are normalized like the scalar kernel. The vector kernels use rsqrt plus a
+// Newton step, which is within a few ulps of that but not bit for bit the same
+static constexpr float tolerance = 1e-6f;
+
+int main()
+{
+	bool passed = true;
+
+	for (unsigned int level = 1; level < bakedIcosphereLevels; level++)
+	{
+		const BakedIcosphere previous = getBakedIcosphere(level - 1);
+		const BakedIcosphere baked = getBakedIcosphere(level);
+
+		// Recompute every midpoint of the level at runtime. Each group of 4 child triangles starts with
+		// (v1, mid1, mid3), (mid1, v2, mid2), (mid3, mid2, v3)
+		std::vector<float> vertices(baked.vertices, baked.vertices + baked.vertexCount * 3);
+
+		auto getVertex = [&](unsigned int index)
+		{
+			return glm::vec3 {vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2]};
+		};
+
+		{
+			MidpointBatch batch(vertices.data());
+
+			for (size_t j = 0; j < previous.triangleCount; j++)
+			{
+				const unsigned int* children = baked.indices + j * 12;
+
+				batch.add(children[1], getVertex(children[0]), getVertex(children[4]));
+				batch.add(children[5], getVertex(children[4]), getVertex(children[8]));
+				batch.add(children[2], getVertex(children[8]), getVertex(children[0]));
+			}
+		}
+
+		float maxDifference = 0.0f;
+
+		for (size_t i = 0; i < baked.vertexCount * 3; i++)
+			maxDifference = std::max(maxDifference, std::abs(vertices[i] - baked.vertices[i]));
+
+		if (maxDifference > tolerance)
+		{
+			std::cout << "Level " << level << ": the " << getMidpointKernelName() << " kernel differs from the baked vertices by " <<
+				maxDifference << "\n";
+			passed = false;
+		}
+	}
+
+	return passed ? 0 : 1;
+}
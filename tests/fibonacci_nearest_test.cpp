@@ -0,0 +1,59 @@
+#include "fibonacci_sphere.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+// The constant-time lookup has to find the point a search over all of them finds
+static constexpr size_t pointCounts[] {2, 3, 5, 10, 100, 1000, 10000, 100000, 1000000};
+static constexpr int directionsPerCount = 100;
+
+int main()
+{
+	ThreadPool threadPool;
+	std::mt19937 generator(1);
+	std::normal_distribution<float> normal;
+
+	bool passed = true;
+
+	for (size_t count : pointCounts)
+	{
+		std::vector<float> points(count * 3);
+		generateFibonacciPoints(threadPool, count, points.data());
+
+		for (int i = 0; i < directionsPerCount; i++)
+		{
+			// Normal coordinates give uniformly spread directions
+			glm::vec3 direction = glm::normalize(glm::vec3(normal(generator), normal(generator), normal(generator)));
+
+			// In double, since neighbours of a million points are too close together for a float dot product
+			auto distanceSquared = [&](size_t index)
+			{
+				double dx = static_cast<double>(direction.x) - points[index * 3];
+				double dy = static_cast<double>(direction.y) - points[index * 3 + 1];
+				double dz = static_cast<double>(direction.z) - points[index * 3 + 2];
+
+				return dx * dx + dy * dy + dz * dz;
+			};
+
+			size_t nearest = 0;
+
+			for (size_t index = 1; index < count; index++)
+			{
+				if (distanceSquared(index) < distanceSquared(nearest))
+					nearest = index;
+			}
+
+			size_t found = findNearestFibonacciPoint(direction, count);
+
+			// Another point exactly as close is a tie, not a miss
+			if (found >= count || distanceSquared(found) > distanceSquared(nearest))
+			{
+				std::cout << count << " points: found " << found << " instead of " << nearest << "\n";
+				passed = false;
+			}
+		}
+	}
+
+	return passed ? 0 : 1;
+}
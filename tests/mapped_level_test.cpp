@@ -0,0 +1,79 @@
+#include "sphere.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// A mesh mapped from a file must give way to the level built after it, with or without the level cache
+static constexpr unsigned int savedLevel = 3;
+static constexpr unsigned int targetLevel = 1;
+static constexpr size_t cacheBudgets[] {0, 64 * 1024 * 1024};
+
+static void generate(Sphere& sphere, SphereType type)
+{
+	if (type == SphereType::HEALPix)
+		sphere.generateHealpixSphere();
+	else if (type == SphereType::OctaSphere)
+		sphere.generateOctasphere();
+	else
+		sphere.generateIcosphere();
+}
+
+int main()
+{
+	const SphereType types[] {SphereType::IcoSphere, SphereType::HEALPix, SphereType::OctaSphere};
+	const char* typeNames[] {"IcoSphere", "HEALPix", "OctaSphere"};
+
+	const std::string path = (std::filesystem::temp_directory_path() / "mapped_level_test.sphmesh").string();
+
+	bool passed = true;
+
+	for (size_t t = 0; t < std::size(types); t++)
+	{
+		Sphere reference;
+		reference.setCacheBudget(0);
+		generate(reference, types[t]);
+		reference.subdivide(targetLevel);
+
+		Sphere source;
+		source.setCacheBudget(0);
+		generate(source, types[t]);
+		source.subdivide(savedLevel);
+
+		if (!source.save(path))
+		{
+			std::cout << typeNames[t] << ": could not save " << path << "\n";
+			passed = false;
+			continue;
+		}
+
+		for (size_t budget : cacheBudgets)
+		{
+			Sphere sphere;
+			sphere.setCacheBudget(budget);
+
+			if (!sphere.loadMapped(path) || !sphere.isMapped())
+			{
+				std::cout << typeNames[t] << ": could not map " << path << "\n";
+				passed = false;
+				continue;
+			}
+
+			sphere.subdivide(targetLevel);
+
+			if (sphere.isMapped() || sphere.getVertexCount() != reference.getVertexCount() ||
+				sphere.getTriangleCount() != reference.getTriangleCount())
+			{
+				std::cout << typeNames[t] << " with a " << budget << " byte cache: level " << targetLevel << " has " <<
+					sphere.getVertexCount() << " vertices and " << sphere.getTriangleCount() << " triangles, expected " <<
+					reference.getVertexCount() << " and " << reference.getTriangleCount() << "\n";
+				passed = false;
+			}
+		}
+	}
+
+	std::remove(path.c_str());
+
+	return passed ? 0 : 1;
+}
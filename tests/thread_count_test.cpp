@@ -0,0 +1,49 @@
+#include "sphere.h"
+
+#include <iostream>
+#include <vector>
+
+// Ranges are split differently for every thread count, and the mesh must come out the same
+static constexpr unsigned int level = 6;
+static constexpr unsigned int threadCounts[] {2, 3, 4, 8};
+
+int main()
+{
+	const SubdivisionMode modes[] {SubdivisionMode::Duplicated, SubdivisionMode::SharedVertices, SubdivisionMode::Direct};
+	const char* modeNames[] {"Duplicated", "SharedVertices", "Direct"};
+
+	bool passed = true;
+
+	for (size_t m = 0; m < std::size(modes); m++)
+	{
+		auto build = [&](unsigned int threadCount, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+		{
+			Sphere sphere;
+			sphere.setCacheBudget(0);
+			sphere.setThreadCount(threadCount);
+			sphere.setSubdivisionMode(modes[m]);
+			sphere.generateIcosphere();
+			sphere.subdivide(level);
+			sphere.releaseMesh(vertices, indices);
+		};
+
+		std::vector<float> serialVertices;
+		std::vector<unsigned int> serialIndices;
+		build(1, serialVertices, serialIndices);
+
+		for (unsigned int threadCount : threadCounts)
+		{
+			std::vector<float> vertices;
+			std::vector<unsigned int> indices;
+			build(threadCount, vertices, indices);
+
+			if (vertices != serialVertices || indices != serialIndices)
+			{
+				std::cout << modeNames[m] << ": " << threadCount << " threads differ from the serial mesh\n";
+				passed = false;
+			}
+		}
+	}
+
+	return passed ? 0 : 1;
+}